@@ -1,11 +1,25 @@
+#include "../include/Curriculum.hpp"
+#include "../include/Evaluation.hpp"
+#include "../include/ExperienceReplay.hpp"
+#include "../include/LinearQFunction.hpp"
+#include "../include/MultiStep.hpp"
+#include "../include/Parallel.hpp"
+#include "../include/Planning.hpp"
+#include "../include/PopulationTraining.hpp"
+#include "../include/QNetwork.hpp"
+#include "../include/Schedules.hpp"
 #include "../include/Sokoban.hpp"
 #include "../include/SokobanQLearning.hpp"
+#include "../include/Sweep.hpp"
 #include "../include/Utils.hpp"
+#include "../include/ValueIteration.hpp"
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <csignal>
 #include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <iomanip>
 #include <iostream>
@@ -13,6 +27,8 @@
 #include <random>
 #include <string>
 #include <thread>
+#include <type_traits>
+#include <vector>
 
 #undef SokobanQLearning_CLI_USE_WINAPI_
 
@@ -35,9 +51,64 @@ namespace {
     bool print_Q_success = false;
     bool print_Q_failure = false;
     bool print_Q_exit = false;
-    long long sleep = 100;
+    long long sleep_ms = 100;
     long long quiet = 0;
+    long long threads = 1;
+    long long benchmark_threads = 0;
+    std::vector<SokobanQLearning::SweepAxis> sweep_axes;
+    long long sweep_random = 0;
+    long long sweep_budget = 1000000;
+    long long pbt = 0;
+    long long pbt_interval = 10000;
+    long long pbt_budget = 1000000;
+    long long replay = 0;
+    long long replay_capacity = 65536;
+    bool backward_replay = false;
+    long long sweeping = 0;
+    double sweeping_threshold = 0.01;
+    long long dyna = 0;
+    bool dyna_resimulate = false;
+    double lambda = 0;
+    double trace_threshold = 0.01;
+    bool double_q = false;
+    double ucb = 0;
+    long long linear = 0;
+    long long network = 0;
+    long long network_envs = 16;
+    long long network_batch = 32;
+    long long network_updates = 4;
+    long long network_sync = 200;
+    double network_rate = 0.03;
+    long long n_step = 1;
+    SokobanQLearning::Schedule<double> epsilon_schedule(0.05);
+    SokobanQLearning::Schedule<double> alpha_schedule(0.5);
+    SokobanQLearning::Schedule<double> reward_scale_schedule(1);
+    bool schedule_episodes = false;
+    long long eval_interval = 0;
+    long long eval_max_steps = 1000;
+    long long stop_after = 0;
+    long long eval_rollouts = 1;
+    long long eval_threads = 1;
+    double discount = 1;
+    double retrace_penalty = 1;
+    double push_reward = 0.5;
+    double goal_reward = 50;
+    double failure_penalty = 1000;
+    double success_reward = 1000;
+    double shaping = 0;
+    long long value_iteration = 0;
+    bool gauss_seidel = false;
+    long long curriculum = 0;
+    double curriculum_threshold = 0.8;
+    long long curriculum_window = 20;
+    long long exploring_starts = 0;
+    double exploring_probability = 0.5;
+    bool exploring_td = false;
     bool random_device = false;
+    bool fixed_seed = false;
+    unsigned long long seed_value = 0;
+    bool deterministic = false;
+    std::string rng = "mt19937";
     std::atomic_bool interrupted;
 
 #ifdef SokobanQLearning_CLI_USE_WINAPI_
@@ -74,7 +145,16 @@ namespace {
         std::cout << "\x1b[H\x1b[2J" << std::flush;
     }
 
-    template <typename RealType, std::size_t StateBits>
+    // Prints an error naming the given options if there are more than one.
+    bool CheckExclusive(const std::vector<std::string> &options) {
+        if (options.size() <= 1) return true;
+        std::cerr << "Conflicting options:";
+        for (const auto &option : options) std::cerr << " " << option;
+        std::cerr << std::endl;
+        return false;
+    }
+
+    template <typename RealType, std::size_t StateBits, class URNG>
     bool RunAlgorithm(std::string maze) {
         std::shared_ptr<Sokoban::Game<StateBits>> game_ptr;
         try {
@@ -86,26 +166,311 @@ namespace {
             return false;
         }
         auto &game = *game_ptr;
-        SokobanQLearning::PrintableQTable<RealType, StateBits> Q;
-        std::mt19937 random_engine(
-            random_device
-                ? std::random_device()()
-                : std::chrono::system_clock::now().time_since_epoch().count());
+        SokobanQLearning::QTable<RealType, StateBits> single_Q;
+        SokobanQLearning::DoubleQTable<RealType, StateBits> double_Q;
+        SokobanQLearning::CountingQTable<RealType, StateBits> counting_Q;
+        std::unique_ptr<SokobanQLearning::LinearQFunction<RealType, StateBits>>
+            linear_Q;
+        SokobanQLearning::IQTable<RealType, StateBits> *Q_ptr = &single_Q;
+        if (double_q)
+            Q_ptr = &double_Q;
+        else if (ucb > 0)
+            Q_ptr = &counting_Q;
+        else if (linear > 0) {
+            linear_Q.reset(
+                new SokobanQLearning::LinearQFunction<RealType, StateBits>(
+                    game, linear));
+            Q_ptr = linear_Q.get();
+        }
+        std::uint_least64_t seed = seed_value;
+        if (!fixed_seed)
+            seed = random_device
+                       ? std::random_device()()
+                       : std::chrono::system_clock::now()
+                             .time_since_epoch()
+                             .count();
+        auto random_engine = Utils::SeedStream<URNG>(seed, 0);
+        if (quiet > 0) std::clog << "Seed: " << seed << std::endl;
         interrupted = false;
         std::signal(SIGINT, [](int) -> void { interrupted = true; });
-        auto train =
-            std::bind(SokobanQLearning::Train<decltype(random_engine), RealType,
-                                              StateBits>,
-                      std::ref(random_engine), std::ref(game), std::ref(Q),
-                      0.05, 0.5f, 1.0f, 1.0f, 0.5f, 50.0f, 1000.0f, 1000.0f);
-        while (!interrupted && quiet-- > 1) train();
-        if (interrupted) {
+        SokobanQLearning::TrainParams<RealType> params{
+            epsilon_schedule.Start,
+            static_cast<RealType>(alpha_schedule.Start),
+            static_cast<RealType>(discount),
+            {static_cast<RealType>(retrace_penalty),
+             static_cast<RealType>(push_reward),
+             static_cast<RealType>(goal_reward),
+             static_cast<RealType>(failure_penalty),
+             static_cast<RealType>(success_reward),
+             static_cast<RealType>(shaping)}};
+        std::unique_ptr<SokobanQLearning::QNetwork<RealType, StateBits>>
+            network_Q;
+        if (network > 0) {
+            network_Q.reset(
+                new SokobanQLearning::QNetwork<RealType, StateBits>(
+                    random_engine, game, network,
+                    static_cast<RealType>(network_rate),
+                    -params.MinQ(game.GetBoxPos0().size())));
+            Q_ptr = network_Q.get();
+        }
+        auto &Q = *Q_ptr;
+        SokobanQLearning::Scheduler<RealType, StateBits> scheduler(params);
+        scheduler.Epsilon = epsilon_schedule;
+        scheduler.Alpha = alpha_schedule;
+        scheduler.RewardScale = reward_scale_schedule;
+        scheduler.PerEpisode = schedule_episodes;
+        const bool scheduled =
+            epsilon_schedule.Kind != SokobanQLearning::ScheduleKind::Constant ||
+            alpha_schedule.Kind != SokobanQLearning::ScheduleKind::Constant ||
+            reward_scale_schedule.Kind !=
+                SokobanQLearning::ScheduleKind::Constant ||
+            reward_scale_schedule.Start != 1;
+        const auto train_step =
+            [&params](auto &random_generator, Sokoban::Game<StateBits> &game,
+                      SokobanQLearning::IQTable<RealType, StateBits> &Q) {
+                return SokobanQLearning::TrainLean(random_generator, game, Q,
+                                                   params);
+            };
+        const auto train_parallel =
+            [&game, &seed, &train_step](
+                const std::size_t &thread_count, const Sokoban::TimeInt &steps,
+                SokobanQLearning::IQTable<RealType, StateBits> &shared_Q) {
+                return SokobanQLearning::TrainParallel<URNG>(
+                    game, thread_count, steps, seed, interrupted,
+                    [&shared_Q, &train_step](
+                        URNG &random_generator,
+                        Sokoban::Game<StateBits> &actor) -> void {
+                        train_step(random_generator, actor, shared_Q);
+                    });
+            };
+        if (pbt > 0) {
+            std::vector<SokobanQLearning::TrainParams<RealType>> configs;
+            if (!sweep_axes.empty())
+                configs = SokobanQLearning::SweepRandom(
+                    random_engine, sweep_axes, params, pbt);
+            else
+                for (long long i = 0; i < pbt; ++i) {
+                    configs.push_back(params);
+                    if (i)
+                        SokobanQLearning::PerturbParams(random_engine,
+                                                        configs.back(), 0.2);
+                }
+            SokobanQLearning::PopulationTraining<URNG, RealType, StateBits>
+                population(game, configs, seed, 0.25, 0.2, eval_max_steps);
+            for (long long trained = 0; trained < pbt_budget && !interrupted;
+                 trained += pbt_interval) {
+                population.Train(std::min(pbt_interval, pbt_budget - trained),
+                                 threads, interrupted);
+                const auto &best = population.Best();
+                std::clog << "Round " << population.GetRounds() << ": ";
+                best.Greedy.Print(std::clog);
+                if (trained + pbt_interval < pbt_budget) population.Exploit();
+            }
+            population.Print(std::cout, 4);
+            return true;
+        }
+        if (!sweep_axes.empty()) {
+            std::vector<SokobanQLearning::TrainParams<RealType>> configs;
+            try {
+                configs = sweep_random > 0
+                              ? SokobanQLearning::SweepRandom(
+                                    random_engine, sweep_axes, params,
+                                    sweep_random)
+                              : SokobanQLearning::SweepGrid(sweep_axes, params);
+            } catch (const std::invalid_argument &err) {
+                std::cerr << "Error: " << err.what() << std::endl;
+                return false;
+            }
+            const auto &results = SokobanQLearning::RunSweep<URNG>(
+                game, configs, sweep_budget,
+                eval_interval > 0 ? eval_interval : 10000, stop_after,
+                eval_max_steps, threads, seed, interrupted);
+            SokobanQLearning::SweepResult<RealType>::PrintCsvHeader(std::cout);
+            for (const auto &r : results) r.PrintCsv(std::cout);
+            return true;
+        }
+        if (benchmark_threads > 0) {
+            std::cout << std::right << std::setfill(' ') << std::setw(12)
+                      << "Threads" << std::setw(16) << "Steps/s"
+                      << std::setw(12) << "Efficiency" << std::endl;
+            double base = 0;
+            for (std::size_t thread_count = 1;
+                 thread_count <= 32 && !interrupted; thread_count <<= 1) {
+                SokobanQLearning::ConcurrentQTable<RealType, StateBits>
+                    shared_Q;
+                const auto &stats = train_parallel(
+                    thread_count, benchmark_threads * thread_count, shared_Q);
+                if (thread_count == 1) base = stats.StepsPerSecond();
+                std::cout << std::setw(12) << thread_count << std::fixed
+                          << std::setprecision(1) << std::setw(16)
+                          << stats.StepsPerSecond() << std::setprecision(3)
+                          << std::setw(12)
+                          << (base > 0 ? stats.StepsPerSecond() /
+                                             (base * thread_count)
+                                       : 0)
+                          << std::endl;
+            }
+            return true;
+        }
+        if (value_iteration > 0) {
+            SokobanQLearning::ValueIteration<RealType, StateBits> solver;
+            if (solver.Build(game, params, value_iteration)) {
+                solver.Solve(params.Gamma, 1e-4f, 100000, threads,
+                             gauss_seidel);
+                solver.Export(Q);
+                solver.GetStats().Print(std::clog, 4);
+            } else
+                std::cerr << "More than " << value_iteration
+                          << " reachable states, skipped value iteration"
+                          << std::endl;
+        }
+        SokobanQLearning::DeepQLearning<RealType, StateBits> deep_Q(
+            game, network_envs, network_Q ? replay_capacity : 0,
+            network_batch, network_updates, network_sync);
+        SokobanQLearning::EpisodeBuffer<RealType, StateBits> episode_buffer;
+        SokobanQLearning::ReplayBuffer<RealType, StateBits> replay_buffer(
+            replay > 0 ? replay_capacity : 0);
+        SokobanQLearning::PrioritizedSweeping<RealType, StateBits>
+            prioritized_sweeping(sweeping_threshold, sweeping);
+        SokobanQLearning::DynaQ<RealType, StateBits> dyna_Q(dyna,
+                                                            dyna_resimulate);
+        SokobanQLearning::EligibilityTraces<RealType, StateBits> traces(
+            lambda, trace_threshold);
+        SokobanQLearning::NStepWindow<RealType, StateBits> window(n_step);
+        SokobanQLearning::ReverseCurriculum<StateBits> reverse_curriculum(
+            game, curriculum_threshold, curriculum_window, curriculum);
+        SokobanQLearning::ExploringStarts<RealType, StateBits> starts(
+            game, exploring_starts, exploring_probability, exploring_td);
+        const auto learn = [&]() {
+            if (n_step > 1)
+                return SokobanQLearning::TrainNStep(random_engine, game, Q,
+                                                    window, params);
+            if (double_q)
+                return SokobanQLearning::TrainDouble(random_engine, game,
+                                                     double_Q, params);
+            if (ucb > 0)
+                return SokobanQLearning::TrainUCB(
+                    random_engine, game, counting_Q,
+                    static_cast<RealType>(ucb), params);
+            if (lambda > 0)
+                return SokobanQLearning::TrainLambda(random_engine, game, Q,
+                                                     traces, params);
+            if (dyna > 0)
+                return SokobanQLearning::TrainDyna(random_engine, game, Q,
+                                                   dyna_Q, params);
+            if (replay > 0)
+                return SokobanQLearning::TrainReplay(
+                    random_engine, game, Q, replay_buffer, replay, params);
+            if (sweeping > 0)
+                return SokobanQLearning::TrainPrioritized(
+                    random_engine, game, Q, prioritized_sweeping, params);
+            if (backward_replay)
+                return SokobanQLearning::TrainBackward(
+                    random_engine, game, Q, episode_buffer, params);
+            return SokobanQLearning::Train(random_engine, game, Q, params);
+        };
+        const auto train = [&]() {
+            if (scheduled) params = scheduler.Next(game);
+            if (curriculum > 0)
+                reverse_curriculum.Next(random_engine, game);
+            else if (exploring_starts > 0)
+                starts.Next(random_engine, game);
+            const auto &result = learn();
+            if (exploring_starts > 0) starts.Add(random_engine, result);
+            return result;
+        };
+        const bool plain = n_step <= 1 && !double_q && ucb <= 0 &&
+                           lambda <= 0 && dyna <= 0 && replay <= 0 &&
+                           sweeping <= 0 && !backward_replay &&
+                           curriculum <= 0 && exploring_starts <= 0;
+        // Parallel actors only run the plain update on a plain table.
+        const bool parallel = plain && !scheduled && Q_ptr == &single_Q;
+        if (threads > 1 && quiet > 1 && !parallel) {
+            std::cerr << "Ignored --threads: only plain Q-learning with "
+                         "constant parameters trains in parallel"
+                      << std::endl;
+        } else if (threads > 1 && quiet > 1 && deterministic) {
+            const auto &stats = SokobanQLearning::TrainIndependent<URNG>(
+                game, threads, quiet - 1, seed, interrupted, Q, train_step);
+            stats.Print(std::clog, 1, 12);
+            quiet = 1;
+        } else if (threads > 1 && quiet > 1) {
+            SokobanQLearning::ConcurrentQTable<RealType, StateBits> shared_Q;
+            // Starts from what value iteration may have filled in.
+            Q.ForEach([&shared_Q](const auto &state, const auto &row) -> void {
+                shared_Q.Set(state, row);
+            });
+            const auto &stats = train_parallel(threads, quiet - 1, shared_Q);
+            shared_Q.ForEach([&Q](const auto &state, const auto &row) -> void {
+                Q.Set(state, row);
+            });
+            stats.Print(std::clog, 1, 12);
+            quiet = 1;
+        }
+        auto start_game = game;
+        start_game.Restart();
+        if (curriculum > 0) reverse_curriculum.Start(random_engine, game);
+        const std::vector<SokobanQLearning::RolloutJob<StateBits>>
+            rollout_jobs(eval_rollouts, {&game, start_game.GetState()});
+        SokobanQLearning::EpisodeStats episode_stats;
+        SokobanQLearning::ConvergenceMonitor monitor(stop_after);
+        Sokoban::TimeInt trained = 0;
+        bool converged = false;
+        while (!interrupted && !converged && quiet > 1) {
+            Sokoban::TimeInt steps =
+                std::min(quiet - 1, static_cast<long long>(65536));
+            if (eval_interval > 0)
+                steps = std::min(steps, static_cast<Sokoban::TimeInt>(
+                                            eval_interval -
+                                            trained % eval_interval));
+            if (network_Q)
+                episode_stats +=
+                    deep_Q.Run(random_engine, *network_Q, params, steps);
+            else if (plain && !scheduled)
+                episode_stats += SokobanQLearning::TrainEpisodes(
+                    random_engine, game, Q, params, 0, steps);
+            else
+                for (Sokoban::TimeInt i = 0; i < steps && !interrupted; ++i) {
+                    if (plain) {
+                        if (scheduled) params = scheduler.Next(game);
+                        train_step(random_engine, game, Q);
+                    } else
+                        train();
+                }
+            quiet -= steps;
+            trained += steps;
+            if (eval_interval > 0 && !(trained % eval_interval)) {
+                std::clog << "Evaluation after " << trained << " steps: ";
+                if (eval_rollouts > 1) {
+                    const SokobanQLearning::EvaluationSummary summary(
+                        SokobanQLearning::EvaluateParallel<URNG>(
+                            rollout_jobs, Q, 0, eval_max_steps, eval_threads,
+                            seed + trained));
+                    summary.Print(std::clog, 1);
+                    converged = monitor.Add(summary);
+                } else {
+                    const auto &result = SokobanQLearning::Evaluate(
+                        random_engine, start_game, Q, 0, eval_max_steps);
+                    result.Print(std::clog);
+                    converged = monitor.Add(result);
+                }
+            }
+        }
+        if (episode_stats.Steps) episode_stats.Print(std::clog, 1);
+        if (converged)
+            std::clog << "Converged after " << trained << " steps"
+                      << std::endl;
+        if (interrupted || converged) {
             std::cout << std::endl;
+            if (dyna > 0) dyna_Q.Stats.Print(std::clog, 4);
+            if (curriculum > 0)
+                std::clog << "Curriculum Distance: "
+                          << reverse_curriculum.GetDistance() << std::endl;
             if (print_Q_exit) Q.Print(std::clog, 4, 12);
             return true;
         }
         SokobanQLearning::TrainResult<RealType, StateBits> train_result =
-            quiet >= 0 ? train()
+            quiet > 0 ? train()
                        : decltype(train_result){game.GetState(),
                                                 Q.Get(game.GetState())};
         while (!interrupted) {
@@ -145,10 +510,20 @@ namespace {
                     Q.Print(std::clog, 4, 12);
                 }
             }
-            if (sleep)
-                std::this_thread::sleep_for(std::chrono::milliseconds(sleep));
+            if (sleep_ms)
+                std::this_thread::sleep_for(
+                    std::chrono::milliseconds(sleep_ms));
             train_result = train();
         }
+        if (dyna > 0) {
+            std::clog << std::endl;
+            dyna_Q.Stats.Print(std::clog, 4);
+        }
+        if (curriculum > 0) {
+            std::clog << std::endl
+                      << "Curriculum Distance: "
+                      << reverse_curriculum.GetDistance() << std::endl;
+        }
         if (print_Q_exit) {
             std::clog << std::endl;
             Q.Print(std::clog, 4, 12);
@@ -179,6 +554,177 @@ int main(int argc, char *argv[]) {
             PrintOption(std::cout, "--quiet=<num>",
                         "Train for <num> steps before doing anything else "
                         "(default value is 0)");
+            PrintOption(std::cout, "--threads=<num>",
+                        "Run the quiet steps of plain Q-learning on <num> "
+                        "parallel actors sharing one Q table (default value "
+                        "is 1)");
+            PrintOption(std::cout, "--benchmark-threads=<num>",
+                        "Measure parallel training throughput with 1 to 32 "
+                        "threads, <num> steps per thread, then exit");
+            PrintOption(std::cout, "--sweep=<spec>",
+                        "Train one table per configuration of the sweep on "
+                        "--threads threads, evaluating every --eval-interval "
+                        "steps (10000 if 0), print a CSV of the results, then "
+                        "exit");
+            PrintOption(std::cout, "--sweep-random=<num>",
+                        "Draw <num> random configurations instead of the grid "
+                        "(default value is 0)");
+            PrintOption(std::cout, "--sweep-budget=<num>",
+                        "Train each configuration for at most <num> steps "
+                        "(default value is 1000000)");
+            PrintOption(std::cout, "--pbt=<num>",
+                        "Train a population of <num> tables on --threads "
+                        "threads, print the population, then exit; with "
+                        "--sweep, every member draws each parameter at "
+                        "random from its axis, lists included, instead of "
+                        "walking the grid (default value is 0)");
+            PrintOption(std::cout, "--pbt-interval=<num>",
+                        "Evaluate every <num> steps, then replace the worst "
+                        "quarter by perturbed copies of the best quarter "
+                        "(default value is 10000)");
+            PrintOption(std::cout, "--pbt-budget=<num>",
+                        "Train each member for <num> steps (default value is "
+                        "1000000)");
+            PrintOption(std::cout, "--replay=<num>",
+                        "Replay <num> stored transitions after each step "
+                        "(default value is 0)");
+            PrintOption(std::cout, "--replay-capacity=<num>",
+                        "Keep the last <num> transitions for replay "
+                        "(default value is 65536)");
+            PrintOption(std::cout, "--backward-replay",
+                        "Replay every successful episode backward, latest "
+                        "step first");
+            PrintOption(std::cout, "--sweeping=<num>",
+                        "Use prioritized sweeping with up to <num> backups "
+                        "per step (default value is 0)");
+            PrintOption(std::cout, "--sweeping-threshold=<num>",
+                        "Only queue pairs whose TD error exceeds <num> "
+                        "(default value is 0.01)");
+            PrintOption(std::cout, "--dyna=<num>",
+                        "Use Dyna-Q with <num> planning updates per step "
+                        "(default value is 0)");
+            PrintOption(std::cout, "--dyna-resimulate",
+                        "Plan by re-simulating visited pairs instead of "
+                        "reading the cached model");
+            PrintOption(std::cout, "--lambda=<num>",
+                        "Use Watkins's Q(lambda) with lambda <num> "
+                        "(default value is 0)");
+            PrintOption(std::cout, "--trace-threshold=<num>",
+                        "Drop eligibility traces smaller than <num> "
+                        "(default value is 0.01)");
+            PrintOption(std::cout, "--double-q",
+                        "Use double Q-learning (doubles the Q table memory)");
+            PrintOption(std::cout, "--ucb=<num>",
+                        "Explore with UCB1 and exploration constant <num> "
+                        "instead of epsilon-greedy (default value is 0)");
+            PrintOption(std::cout, "--linear=<num>",
+                        "Approximate Q linearly over local features hashed "
+                        "into 2^<num> buckets of 16 bytes instead of a table, "
+                        "at most 22 (64 MB); rollouts then run on one thread "
+                        "(default value is 0)");
+            PrintOption(std::cout, "--network=<num>",
+                        "Approximate Q with a neural network of two hidden "
+                        "layers of <num> units, trained by deep Q-learning "
+                        "in the quiet steps; needs --gamma below 1 to learn, "
+                        "and rollouts then run on one thread (default value "
+                        "is 0)");
+            PrintOption(std::cout, "--network-envs=<num>",
+                        "Step <num> environments per batched forward pass "
+                        "(default value is 16)");
+            PrintOption(std::cout, "--network-batch=<num>",
+                        "Learn minibatches of <num> transitions replayed "
+                        "from the last --replay-capacity (default value is "
+                        "32)");
+            PrintOption(std::cout, "--network-updates=<num>",
+                        "Learn <num> minibatches per batched step (default "
+                        "value is 4)");
+            PrintOption(std::cout, "--network-sync=<num>",
+                        "Sync the target network every <num> minibatches "
+                        "(default value is 200)");
+            PrintOption(std::cout, "--network-rate=<num>",
+                        "Learning rate of the network (default value is "
+                        "0.03)");
+            PrintOption(std::cout, "--n-step=<num>",
+                        "Update with <num>-step returns (default value is 1)");
+            PrintOption(std::cout, "--epsilon=<schedule>",
+                        "Schedule of the exploration rate (default value is "
+                        "0.05)");
+            PrintOption(std::cout, "--alpha=<schedule>",
+                        "Schedule of the learning rate (default value is 0.5)");
+            PrintOption(std::cout, "--reward-scale=<schedule>",
+                        "Schedule of the factor applied to push and goal "
+                        "rewards (default value is 1)");
+            PrintOption(std::cout, "--schedule-episodes",
+                        "Advance schedules once per episode instead of once "
+                        "per step");
+            PrintOption(std::cout, "--eval-interval=<num>",
+                        "Evaluate the greedy policy every <num> quiet steps "
+                        "(default value is 0)");
+            PrintOption(std::cout, "--eval-max-steps=<num>",
+                        "Give up an evaluation after <num> steps (default "
+                        "value is 1000)");
+            PrintOption(std::cout, "--stop-after=<num>",
+                        "Stop once <num> evaluations in a row solve the level "
+                        "in the same number of steps (default value is 0)");
+            PrintOption(std::cout, "--eval-rollouts=<num>",
+                        "Play <num> greedy rollouts per evaluation (default "
+                        "value is 1)");
+            PrintOption(std::cout, "--eval-threads=<num>",
+                        "Play the rollouts on <num> threads (default value "
+                        "is 1)");
+            PrintOption(std::cout, "--gamma=<num>",
+                        "Discount factor (default value is 1)");
+            PrintOption(std::cout, "--retrace-penalty=<num>",
+                        "Reward lost on returning to a state visited in the "
+                        "same episode (default value is 1)");
+            PrintOption(std::cout, "--push-reward=<num>",
+                        "Reward for pushing a box (default value is 0.5)");
+            PrintOption(std::cout, "--goal-reward=<num>",
+                        "Reward for each box pushed onto a goal, lost when "
+                        "pushed off (default value is 50)");
+            PrintOption(std::cout, "--failure-penalty=<num>",
+                        "Reward lost on failing (default value is 1000)");
+            PrintOption(std::cout, "--success-reward=<num>",
+                        "Reward for solving the level (default value is "
+                        "1000)");
+            PrintOption(std::cout, "--shaping=<num>",
+                        "Weight of potential-based shaping by the push "
+                        "distance of the boxes to the goals (default value "
+                        "is 0)");
+            PrintOption(std::cout, "--value-iteration=<num>",
+                        "Solve the level exactly before training if it has "
+                        "at most <num> reachable states, using --threads "
+                        "threads; needs --gamma below 1 to converge (default "
+                        "value is 0)");
+            PrintOption(std::cout, "--gauss-seidel",
+                        "Update values in place during value iteration");
+            PrintOption(std::cout, "--curriculum=<num>",
+                        "Start episodes a few box pulls away from solved, up "
+                        "to <num> pulls, then from the level's start (default "
+                        "value is 0)");
+            PrintOption(std::cout, "--curriculum-threshold=<num>",
+                        "Add a pull once the success rate reaches <num> "
+                        "(default value is 0.8)");
+            PrintOption(std::cout, "--curriculum-window=<num>",
+                        "Measure the success rate over <num> episodes "
+                        "(default value is 20)");
+            PrintOption(std::cout, "--exploring-starts=<num>",
+                        "Keep a sample of <num> visited states and start "
+                        "episodes from them (default value is 0)");
+            PrintOption(std::cout, "--exploring-probability=<num>",
+                        "Start from a sampled state with probability <num> "
+                        "(default value is 0.5)");
+            PrintOption(std::cout, "--exploring-td",
+                        "Sample visited states by their TD error");
+            PrintOption(std::cout, "--rng=<name>",
+                        "Random number generator, mt19937 or xoshiro "
+                        "(xoshiro256**) (default value is mt19937)");
+            PrintOption(std::cout, "--seed=<num>",
+                        "Seed the random number generators with <num>");
+            PrintOption(std::cout, "--deterministic",
+                        "With --threads, train a private table per thread "
+                        "and average them, so that runs with the same seed "
+                        "and thread count give the same table");
             PrintOption(std::cout, "--random-device",
                         "Obtain the random seed from the system random device "
                         "instead of the system time (NOT GUARANTEED TO WORK)");
@@ -192,6 +738,26 @@ int main(int argc, char *argv[]) {
                         "Clear the console using ansi escape sequences instead "
                         "of calling Windows APIs");
 #endif
+            std::cout << std::endl
+                      << "Schedules:" << std::endl;
+            PrintOption(std::cout, "<num>", "Constant <num>");
+            PrintOption(std::cout, "linear:<a>:<b>:<n>",
+                        "From <a> to <b> linearly over <n> steps");
+            PrintOption(std::cout, "exp:<a>:<b>:<r>",
+                        "<a> * <r> ^ steps, at least <b>");
+            PrintOption(std::cout, "visits:<a>:<b>:<p>",
+                        "<a> / (1 + visits to the state) ^ <p>, at least <b>");
+            std::cout << std::endl
+                      << "Sweeps:" << std::endl;
+            PrintOption(std::cout, "<name>=<v>,<v>,...",
+                        "Try each value of <name>, one of epsilon, alpha, "
+                        "gamma, retrace, push, goal, failure, success and "
+                        "shaping");
+            PrintOption(std::cout, "<name>=<a>:<b>",
+                        "Draw <name> uniformly from <a> to <b>, with "
+                        "--sweep-random only");
+            PrintOption(std::cout, "<axis>;<axis>;...",
+                        "Sweep several parameters at once");
             std::cout << std::endl;
             return 0;
         } else if (arg == "--print-q") {
@@ -204,7 +770,7 @@ int main(int argc, char *argv[]) {
             print_Q_exit = true;
         } else if (!arg.compare(0, 8, "--sleep=")) {
             try {
-                sleep = std::stoll(arg.substr(8));
+                sleep_ms = std::stoll(arg.substr(8));
             } catch (const std::invalid_argument &) {
                 std::cerr << "Ignored invalid option: " + arg << std::endl;
             }
@@ -214,6 +780,305 @@ int main(int argc, char *argv[]) {
             } catch (const std::invalid_argument &) {
                 std::cerr << "Ignored invalid option: " + arg << std::endl;
             }
+        } else if (!arg.compare(0, 10, "--threads=")) {
+            try {
+                threads = std::stoll(arg.substr(10));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 8, "--sweep=")) {
+            try {
+                sweep_axes = SokobanQLearning::ParseSweep(arg.substr(8));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 15, "--sweep-random=")) {
+            try {
+                sweep_random = std::stoll(arg.substr(15));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 15, "--sweep-budget=")) {
+            try {
+                sweep_budget = std::stoll(arg.substr(15));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 6, "--pbt=")) {
+            try {
+                pbt = std::stoll(arg.substr(6));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 15, "--pbt-interval=")) {
+            try {
+                pbt_interval = std::stoll(arg.substr(15));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 13, "--pbt-budget=")) {
+            try {
+                pbt_budget = std::stoll(arg.substr(13));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 20, "--benchmark-threads=")) {
+            try {
+                benchmark_threads = std::stoll(arg.substr(20));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 9, "--replay=")) {
+            try {
+                replay = std::stoll(arg.substr(9));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 18, "--replay-capacity=")) {
+            try {
+                replay_capacity = std::stoll(arg.substr(18));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (arg == "--backward-replay") {
+            backward_replay = true;
+        } else if (!arg.compare(0, 11, "--sweeping=")) {
+            try {
+                sweeping = std::stoll(arg.substr(11));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 21, "--sweeping-threshold=")) {
+            try {
+                sweeping_threshold = std::stod(arg.substr(21));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 7, "--dyna=")) {
+            try {
+                dyna = std::stoll(arg.substr(7));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (arg == "--dyna-resimulate") {
+            dyna_resimulate = true;
+        } else if (!arg.compare(0, 9, "--lambda=")) {
+            try {
+                lambda = std::stod(arg.substr(9));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 18, "--trace-threshold=")) {
+            try {
+                trace_threshold = std::stod(arg.substr(18));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (arg == "--double-q") {
+            double_q = true;
+        } else if (!arg.compare(0, 9, "--linear=")) {
+            try {
+                linear = std::stoll(arg.substr(9));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 10, "--network=")) {
+            try {
+                network = std::stoll(arg.substr(10));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 15, "--network-envs=")) {
+            try {
+                network_envs = std::stoll(arg.substr(15));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 16, "--network-batch=")) {
+            try {
+                network_batch = std::stoll(arg.substr(16));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 18, "--network-updates=")) {
+            try {
+                network_updates = std::stoll(arg.substr(18));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 15, "--network-sync=")) {
+            try {
+                network_sync = std::stoll(arg.substr(15));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 15, "--network-rate=")) {
+            try {
+                network_rate = std::stod(arg.substr(15));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 6, "--ucb=")) {
+            try {
+                ucb = std::stod(arg.substr(6));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 9, "--n-step=")) {
+            try {
+                n_step = std::stoll(arg.substr(9));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 10, "--epsilon=")) {
+            try {
+                epsilon_schedule =
+                    SokobanQLearning::ParseSchedule<double>(arg.substr(10));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 8, "--alpha=")) {
+            try {
+                alpha_schedule =
+                    SokobanQLearning::ParseSchedule<double>(arg.substr(8));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 15, "--reward-scale=")) {
+            try {
+                reward_scale_schedule =
+                    SokobanQLearning::ParseSchedule<double>(arg.substr(15));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (arg == "--schedule-episodes") {
+            schedule_episodes = true;
+        } else if (!arg.compare(0, 16, "--eval-interval=")) {
+            try {
+                eval_interval = std::stoll(arg.substr(16));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 17, "--eval-max-steps=")) {
+            try {
+                eval_max_steps = std::stoll(arg.substr(17));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 13, "--stop-after=")) {
+            try {
+                stop_after = std::stoll(arg.substr(13));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 16, "--eval-rollouts=")) {
+            try {
+                eval_rollouts = std::stoll(arg.substr(16));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 15, "--eval-threads=")) {
+            try {
+                eval_threads = std::stoll(arg.substr(15));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 8, "--gamma=")) {
+            try {
+                discount = std::stod(arg.substr(8));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 18, "--retrace-penalty=")) {
+            try {
+                retrace_penalty = std::stod(arg.substr(18));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 14, "--push-reward=")) {
+            try {
+                push_reward = std::stod(arg.substr(14));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 14, "--goal-reward=")) {
+            try {
+                goal_reward = std::stod(arg.substr(14));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 18, "--failure-penalty=")) {
+            try {
+                failure_penalty = std::stod(arg.substr(18));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 17, "--success-reward=")) {
+            try {
+                success_reward = std::stod(arg.substr(17));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 10, "--shaping=")) {
+            try {
+                shaping = std::stod(arg.substr(10));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 18, "--value-iteration=")) {
+            try {
+                value_iteration = std::stoll(arg.substr(18));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (arg == "--gauss-seidel") {
+            gauss_seidel = true;
+        } else if (!arg.compare(0, 13, "--curriculum=")) {
+            try {
+                curriculum = std::stoll(arg.substr(13));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 23, "--curriculum-threshold=")) {
+            try {
+                curriculum_threshold = std::stod(arg.substr(23));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 20, "--curriculum-window=")) {
+            try {
+                curriculum_window = std::stoll(arg.substr(20));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 19, "--exploring-starts=")) {
+            try {
+                exploring_starts = std::stoll(arg.substr(19));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (!arg.compare(0, 24, "--exploring-probability=")) {
+            try {
+                exploring_probability = std::stod(arg.substr(24));
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (arg == "--exploring-td") {
+            exploring_td = true;
+        } else if (!arg.compare(0, 6, "--rng=")) {
+            if (arg.substr(6) == "mt19937" || arg.substr(6) == "xoshiro")
+                rng = arg.substr(6);
+            else
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+        } else if (!arg.compare(0, 7, "--seed=")) {
+            try {
+                seed_value = std::stoull(arg.substr(7));
+                fixed_seed = true;
+            } catch (const std::invalid_argument &) {
+                std::cerr << "Ignored invalid option: " + arg << std::endl;
+            }
+        } else if (arg == "--deterministic") {
+            deterministic = true;
         } else if (arg == "--random-device") {
             random_device = true;
 #ifdef SokobanQLearning_USE_EMOJI_
@@ -228,11 +1093,113 @@ int main(int argc, char *argv[]) {
             std::cerr << "Ignored invalid argument: " + arg << std::endl;
         }
     }
-    if (sleep < 0) sleep = 0;
+    if (sleep_ms < 0) sleep_ms = 0;
     if (quiet < 0) quiet = 0;
+    if (threads < 1) threads = 1;
+    if (sweep_random < 0) sweep_random = 0;
+    if (sweep_budget < 1) sweep_budget = 1;
+    if (pbt < 0) pbt = 0;
+    if (pbt_interval < 1) pbt_interval = 1;
+    if (pbt_budget < 1) pbt_budget = 1;
+    if (replay < 0) replay = 0;
+    if (replay_capacity < 1) replay_capacity = 1;
+    if (sweeping < 0) sweeping = 0;
+    if (sweeping_threshold < 0) sweeping_threshold = 0;
+    if (dyna < 0) dyna = 0;
+    if (lambda < 0) lambda = 0;
+    if (lambda > 1) lambda = 1;
+    if (ucb < 0) ucb = 0;
+    if (linear < 0) linear = 0;
+    if (linear > 22) linear = 22;
+    if (network < 0) network = 0;
+    if (network_envs < 1) network_envs = 1;
+    if (network_batch < 1) network_batch = 1;
+    if (network_updates < 0) network_updates = 0;
+    if (network_sync < 1) network_sync = 1;
+    if (network_rate < 0) network_rate = 0;
+    if (n_step < 1) n_step = 1;
+    if (eval_interval < 0) eval_interval = 0;
+    if (eval_max_steps < 0) eval_max_steps = 0;
+    if (stop_after < 0) stop_after = 0;
+    if (eval_rollouts < 1) eval_rollouts = 1;
+    if (eval_threads < 1) eval_threads = 1;
+    if (discount < 0) discount = 0;
+    if (discount > 1) discount = 1;
+    if (value_iteration < 0) value_iteration = 0;
+    if (curriculum < 0) curriculum = 0;
+    if (curriculum_window < 1) curriculum_window = 1;
+    if (exploring_starts < 0) exploring_starts = 0;
+    if (exploring_probability < 0) exploring_probability = 0;
+    if (exploring_probability > 1) exploring_probability = 1;
+    std::vector<std::string> learners, tables;
+    if (n_step > 1) learners.push_back("--n-step");
+    if (double_q) learners.push_back("--double-q");
+    if (ucb > 0) learners.push_back("--ucb");
+    if (lambda > 0) learners.push_back("--lambda");
+    if (dyna > 0) learners.push_back("--dyna");
+    if (replay > 0) learners.push_back("--replay");
+    if (sweeping > 0) learners.push_back("--sweeping");
+    if (backward_replay) learners.push_back("--backward-replay");
+    if (network > 0) learners.push_back("--network");
+    if (double_q) tables.push_back("--double-q");
+    if (ucb > 0) tables.push_back("--ucb");
+    if (linear > 0) tables.push_back("--linear");
+    if (network > 0) tables.push_back("--network");
+    std::vector<std::string> starts;
+    if (curriculum > 0) starts.push_back("--curriculum");
+    if (exploring_starts > 0) starts.push_back("--exploring-starts");
+    if (!CheckExclusive(learners) || !CheckExclusive(tables) ||
+        !CheckExclusive(starts))
+        return EXIT_FAILURE;
+    // Options that only the step-by-step training loop applies.
+    std::vector<std::string> loop_only(starts);
+    if (epsilon_schedule.Kind != SokobanQLearning::ScheduleKind::Constant)
+        loop_only.push_back("--epsilon");
+    if (alpha_schedule.Kind != SokobanQLearning::ScheduleKind::Constant)
+        loop_only.push_back("--alpha");
+    if (reward_scale_schedule.Kind !=
+            SokobanQLearning::ScheduleKind::Constant ||
+        reward_scale_schedule.Start != 1)
+        loop_only.push_back("--reward-scale");
+    if (network > 0) {
+        // DeepQLearning steps its own environments with fixed parameters.
+        std::vector<std::string> options{"--network"};
+        options.insert(options.end(), loop_only.begin(), loop_only.end());
+        if (!CheckExclusive(options)) return EXIT_FAILURE;
+        if (discount >= 1)
+            std::cerr << "Warning: --network rarely learns with --gamma=1"
+                      << std::endl;
+    }
+    if (pbt > 0 || !sweep_axes.empty()) {
+        // Sweeps and populations train plain tables with the plain update.
+        std::vector<std::string> options{pbt > 0 ? "--pbt" : "--sweep"};
+        options.insert(options.end(), learners.begin(), learners.end());
+        if (linear > 0) options.push_back("--linear");
+        if (value_iteration > 0) options.push_back("--value-iteration");
+        options.insert(options.end(), loop_only.begin(), loop_only.end());
+        if (!CheckExclusive(options)) return EXIT_FAILURE;
+    }
+    if (linear > 0 || network > 0) {
+        // Approximators have no rows to print.
+        std::vector<std::string> options{linear > 0 ? "--linear"
+                                                    : "--network"};
+        if (print_Q_success || print_Q_failure || print_Q_exit)
+            options.push_back("--print-q");
+        if (!CheckExclusive(options)) return EXIT_FAILURE;
+    }
+    // Approximators reuse scratch buffers in Get.
+    if (eval_threads > 1 && (linear > 0 || network > 0)) {
+        std::cerr << "Ignored --eval-threads: the approximator is read from "
+                     "one thread"
+                  << std::endl;
+        eval_threads = 1;
+    }
     char c;
     std::string maze;
     while (std::cin >> std::noskipws >> c) maze += c;
-    return RunAlgorithm<float, 64>(std::move(maze)) ? EXIT_SUCCESS
-                                                    : EXIT_FAILURE;
+    const bool success =
+        rng == "xoshiro"
+            ? RunAlgorithm<float, 64, Utils::Xoshiro256>(std::move(maze))
+            : RunAlgorithm<float, 64, std::mt19937>(std::move(maze));
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
 }
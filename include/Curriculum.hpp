@@ -0,0 +1,256 @@
+#ifndef SokobanQLearning_Curriculum_HPP_
+#define SokobanQLearning_Curriculum_HPP_ 1
+
+#include "./Sokoban.hpp"
+#include "./SokobanQLearning.hpp"
+#include "./Utils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <set>
+#include <vector>
+
+namespace SokobanQLearning {
+    // Starts episodes from positions Distance pulls away from solved: the
+    // boxes are put on random goals, and each pull moves the player one cell
+    // away from an adjacent box, which follows. After every Window episodes
+    // whose success rate reaches Threshold, Distance grows by one, and once
+    // it passes MaxDistance episodes start from the level's own start again.
+    template <std::size_t StateBits>
+    class ReverseCurriculum {
+    public:
+        typedef Sokoban::Game<StateBits> GameType;
+
+        double Threshold;
+        std::size_t Window;
+        Sokoban::TimeInt MaxDistance;
+
+    protected:
+        Sokoban::Pos _player_pos0;
+        std::set<Sokoban::Pos> _box_pos0;
+        Sokoban::TimeInt _distance;
+        std::size_t _episodes, _successes;
+        std::vector<Sokoban::Pos> _region;
+        std::vector<bool> _visited;
+
+        static bool IsFloor(const GameType &game, const Sokoban::Pos &p) {
+            return p.first >= 0 && p.first < game.GetHeight() &&
+                   p.second >= 0 && p.second < game.GetWidth() &&
+                   game.GetFloorIndex()[p.first][p.second] >= 0;
+        }
+
+        static Sokoban::Pos Add(const Sokoban::Pos &p,
+                                const Sokoban::DirectionInt &direction,
+                                const Sokoban::MazeInt &sign = 1) {
+            const auto &movement = Sokoban::Movement(direction);
+            return Sokoban::Pos(p.first + sign * movement.first,
+                                p.second + sign * movement.second);
+        }
+
+        // Fills _region with the cells the player can walk to.
+        void Walk(const GameType &game, const Sokoban::Pos &player_pos,
+                  const std::set<Sokoban::Pos> &box_pos) {
+            _region.assign(1, player_pos);
+            _visited.assign(game.GetFloorPos().size(), false);
+            _visited[game.GetFloorIndex()[player_pos.first]
+                                         [player_pos.second]] = true;
+            for (std::size_t i = 0; i < _region.size(); ++i)
+                for (const auto &d : Sokoban::AllDirections) {
+                    const auto &p = Add(_region[i], d);
+                    if (!IsFloor(game, p) || box_pos.count(p)) continue;
+                    const auto &index = game.GetFloorIndex()[p.first][p.second];
+                    if (_visited[index]) continue;
+                    _visited[index] = true;
+                    _region.push_back(p);
+                }
+        }
+
+    public:
+        const Sokoban::TimeInt &GetDistance() const { return _distance; }
+
+        bool Finished() const { return _distance > MaxDistance; }
+
+        // Counts one finished episode, and returns whether Distance grew.
+        bool Record(bool succeeded) {
+            if (Finished()) return false;
+            ++_episodes;
+            _successes += succeeded;
+            if (_episodes < Window) return false;
+            const bool passed = _successes >= Threshold * _episodes;
+            _episodes = _successes = 0;
+            if (passed) ++_distance;
+            return passed;
+        }
+
+        // Sets a new start on `game` and restarts it.
+        template <class URNG>
+        void Start(URNG &random_generator, GameType &game) {
+            if (Finished()) {
+                game.SetStart(_player_pos0, _box_pos0);
+                game.Restart();
+                return;
+            }
+            std::vector<Sokoban::Pos> cells(game.GetGoalPos().begin(),
+                                            game.GetGoalPos().end());
+            for (std::size_t i = 0; i < _box_pos0.size(); ++i)
+                std::swap(cells[i],
+                          cells[i + Utils::UniformInt(random_generator,
+                                                      cells.size() - i)]);
+            std::set<Sokoban::Pos> box_pos(
+                cells.begin(), cells.begin() + _box_pos0.size());
+            cells.clear();
+            for (const auto &p : game.GetFloorPos())
+                if (!box_pos.count(p)) cells.push_back(p);
+            auto player_pos =
+                cells[Utils::UniformInt(random_generator, cells.size())];
+            std::vector<std::pair<Sokoban::Pos, Sokoban::DirectionInt>> pulls;
+            for (Sokoban::TimeInt i = 0; i < _distance; ++i) {
+                Walk(game, player_pos, box_pos);
+                pulls.clear();
+                for (const auto &p : _region)
+                    for (const auto &d : Sokoban::AllDirections) {
+                        const auto &to = Add(p, d);
+                        if (IsFloor(game, to) && !box_pos.count(to) &&
+                            box_pos.count(Add(p, d, -1)))
+                            pulls.emplace_back(p, d);
+                    }
+                if (pulls.empty()) break;
+                const auto &pull =
+                    pulls[Utils::UniformInt(random_generator, pulls.size())];
+                box_pos.erase(Add(pull.first, pull.second, -1));
+                box_pos.insert(pull.first);
+                player_pos = Add(pull.first, pull.second);
+            }
+            Walk(game, player_pos, box_pos);
+            game.SetStart(
+                _region[Utils::UniformInt(random_generator, _region.size())],
+                box_pos);
+            game.Restart();
+        }
+
+        // Call before every step; once the episode on `game` has ended, its
+        // outcome is recorded and a new one is started.
+        template <class URNG>
+        bool Next(URNG &random_generator, GameType &game) {
+            if (!game.GetSucceeded() && !game.GetFailed()) return false;
+            Record(game.GetSucceeded());
+            Start(random_generator, game);
+            return true;
+        }
+
+        ReverseCurriculum(const GameType &game, const double &threshold,
+                          const std::size_t &window,
+                          const Sokoban::TimeInt &max_distance)
+            : Threshold(threshold),
+              Window(std::max(window, static_cast<std::size_t>(1))),
+              MaxDistance(max_distance),
+              _player_pos0(game.GetPlayerPos0()),
+              _box_pos0(game.GetBoxPos0()),
+              _distance(1),
+              _episodes(0),
+              _successes(0) {}
+    };
+
+    // A fixed-size weighted reservoir (Efraimidis and Spirakis) of the states
+    // steps were taken from, so none of them had failed. With Weighted, a
+    // visit counts as much as the TD error of its update, otherwise all
+    // visits count the same. Each episode starts from a random state of the
+    // reservoir with probability Probability, otherwise from the level's own
+    // start.
+    template <class RealType, std::size_t StateBits>
+    class ExploringStarts {
+    public:
+        typedef Sokoban::Game<StateBits> GameType;
+        typedef typename GameType::StateType StateType;
+
+        double Probability;
+        bool Weighted;
+
+    protected:
+        struct Entry {
+            double Key;
+            StateType State;
+
+            bool operator>(const Entry &other) const {
+                return Key > other.Key;
+            }
+        };
+
+        std::vector<Entry> _entries;
+        std::size_t _capacity;
+        Sokoban::Pos _player_pos0;
+        std::set<Sokoban::Pos> _box_pos0;
+
+    public:
+        std::size_t Size() const { return _entries.size(); }
+
+        const std::size_t &Capacity() const { return _capacity; }
+
+        void Clear() { _entries.clear(); }
+
+        template <class URNG>
+        void Add(URNG &random_generator,
+                 const TrainResult<RealType, StateBits> &result) {
+            if (!_capacity || result.Action == Sokoban::NoDirection) return;
+            const auto &index = Sokoban::DirectionIndex(result.Action);
+            const double weight =
+                Weighted ? std::abs(result.NewRow[index] -
+                                    result.OldRow[index]) +
+                               1e-6
+                         : 1;
+            const Entry entry{
+                std::log(1 - Utils::UniformReal(random_generator)) / weight,
+                result.LastState};
+            if (_entries.size() < _capacity) {
+                _entries.push_back(entry);
+                std::push_heap(_entries.begin(), _entries.end(),
+                               std::greater<Entry>());
+            } else if (entry.Key > _entries.front().Key) {
+                std::pop_heap(_entries.begin(), _entries.end(),
+                              std::greater<Entry>());
+                _entries.back() = entry;
+                std::push_heap(_entries.begin(), _entries.end(),
+                               std::greater<Entry>());
+            }
+        }
+
+        // Sets a new start on `game` and restarts it.
+        template <class URNG>
+        void Start(URNG &random_generator, GameType &game) {
+            Sokoban::Pos player_pos = _player_pos0;
+            std::set<Sokoban::Pos> box_pos = _box_pos0;
+            if (_entries.size() &&
+                Utils::UniformReal(random_generator) < Probability)
+                game.Decode(
+                    _entries[Utils::UniformInt(random_generator,
+                                               _entries.size())]
+                        .State,
+                    player_pos, box_pos);
+            game.SetStart(player_pos, box_pos);
+            game.Restart();
+        }
+
+        // Call before every step; once the episode on `game` has ended, a
+        // new one is started.
+        template <class URNG>
+        bool Next(URNG &random_generator, GameType &game) {
+            if (!game.GetSucceeded() && !game.GetFailed()) return false;
+            Start(random_generator, game);
+            return true;
+        }
+
+        ExploringStarts(const GameType &game, const std::size_t &capacity,
+                        const double &probability, bool weighted)
+            : Probability(probability),
+              Weighted(weighted),
+              _capacity(capacity),
+              _player_pos0(game.GetPlayerPos0()),
+              _box_pos0(game.GetBoxPos0()) {
+            _entries.reserve(_capacity);
+        }
+    };
+}  // namespace SokobanQLearning
+
+#endif  // SokobanQLearning_Curriculum_HPP_
@@ -0,0 +1,170 @@
+#ifndef SokobanQLearning_Evaluation_HPP_
+#define SokobanQLearning_Evaluation_HPP_ 1
+
+#include "./Parallel.hpp"
+#include "./Sokoban.hpp"
+#include "./SokobanQLearning.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <random>
+#include <vector>
+
+namespace SokobanQLearning {
+    struct EvaluationResult {
+        bool Solved = false;
+        Sokoban::TimeInt Steps = 0, Pushes = 0;
+
+        void Print(std::ostream &os) const {
+            if (Solved)
+                os << "Solved in " << Steps << " steps (" << Pushes
+                   << " pushes)" << std::endl;
+            else
+                os << "Not solved after " << Steps << " steps" << std::endl;
+        }
+    };
+
+    // Plays on from the current position of `episode`, choosing actions with
+    // FindAction, for at most `max_steps` steps. With epsilon 0 this is the
+    // greedy policy, ties still being broken at random. Q is only read.
+    template <class URNG, class RealType, std::size_t StateBits>
+    EvaluationResult Rollout(URNG &random_generator,
+                             Sokoban::Game<StateBits> &episode,
+                             const IQTable<RealType, StateBits> &Q,
+                             const double &epsilon,
+                             const Sokoban::TimeInt &max_steps) {
+        EvaluationResult result;
+        while (!episode.GetSucceeded() && !episode.GetFailed() &&
+               result.Steps < max_steps) {
+            result.Pushes += episode.Move(
+                FindAction(random_generator, epsilon, episode, Q));
+            ++result.Steps;
+        }
+        result.Solved = episode.GetSucceeded();
+        return result;
+    }
+
+    // Plays one episode from the start of a copy of `game`.
+    template <class URNG, class RealType, std::size_t StateBits>
+    EvaluationResult Evaluate(URNG &random_generator,
+                              const Sokoban::Game<StateBits> &game,
+                              const IQTable<RealType, StateBits> &Q,
+                              const double &epsilon,
+                              const Sokoban::TimeInt &max_steps) {
+        auto episode = game;
+        episode.Restart();
+        return Rollout(random_generator, episode, Q, epsilon, max_steps);
+    }
+
+    template <std::size_t StateBits>
+    struct RolloutJob {
+        const Sokoban::Game<StateBits> *Level;
+        typename Sokoban::Game<StateBits>::StateType Start;
+    };
+
+    struct EvaluationSummary {
+        std::size_t Jobs = 0, Solved = 0;
+        Sokoban::TimeInt MaxSteps = 0;
+        double MeanSteps = 0, MeanPushes = 0;
+
+        bool AllSolved() const { return Jobs && Solved == Jobs; }
+
+        void Print(std::ostream &os, int precision) const {
+            os << std::fixed << std::setprecision(precision) << "Solved "
+               << Solved << "/" << Jobs << ", " << MeanSteps
+               << " steps and " << MeanPushes << " pushes on average"
+               << std::endl;
+        }
+
+        explicit EvaluationSummary(
+            const std::vector<EvaluationResult> &results) {
+            for (const auto &r : results) {
+                ++Jobs;
+                Solved += r.Solved;
+                MaxSteps = std::max(MaxSteps, r.Steps);
+                MeanSteps += r.Steps;
+                MeanPushes += r.Pushes;
+            }
+            if (Jobs) {
+                MeanSteps /= Jobs;
+                MeanPushes /= Jobs;
+            }
+        }
+    };
+
+    // Runs one rollout per job, from a copy of the job's level restored to
+    // its start state, on `thread_count` threads. Q is shared without locks,
+    // so it must be a table whose const reads are safe to run concurrently,
+    // such as QTable, and must not be written meanwhile. Every job draws from
+    // a generator seeded by `seed` and its index, so the results do not
+    // depend on the number of threads.
+    template <class URNG, class RealType, std::size_t StateBits>
+    std::vector<EvaluationResult> EvaluateParallel(
+        const std::vector<RolloutJob<StateBits>> &jobs,
+        const IQTable<RealType, StateBits> &Q, const double &epsilon,
+        const Sokoban::TimeInt &max_steps, const std::size_t &thread_count,
+        const std::uint_least64_t &seed) {
+        std::vector<EvaluationResult> results(jobs.size());
+        ParallelFor(
+            thread_count, jobs.size(),
+            [&](const std::size_t &job, const std::size_t &) -> void {
+                std::seed_seq seeds{
+                    static_cast<std::uint_least32_t>(seed),
+                    static_cast<std::uint_least32_t>(seed >> 32),
+                    static_cast<std::uint_least32_t>(job),
+                    static_cast<std::uint_least32_t>(
+                        static_cast<std::uint_least64_t>(job) >> 32)};
+                URNG random_generator(seeds);
+                auto episode = *jobs[job].Level;
+                episode.Restore(jobs[job].Start);
+                results[job] = Rollout(random_generator, episode, Q, epsilon,
+                                       max_steps);
+            });
+        return results;
+    }
+
+    // Tracks consecutive evaluations that solve the level with the same
+    // solution length, and reports convergence after Required of them.
+    class ConvergenceMonitor {
+    public:
+        std::size_t Required;
+
+    protected:
+        std::size_t _streak;
+        Sokoban::TimeInt _length;
+
+    public:
+        const std::size_t &GetStreak() const { return _streak; }
+
+        bool Converged() const { return Required && _streak >= Required; }
+
+        bool Add(const EvaluationResult &result) {
+            if (!result.Solved)
+                _streak = 0;
+            else if (_streak && result.Steps == _length)
+                ++_streak;
+            else {
+                _streak = 1;
+                _length = result.Steps;
+            }
+            return Converged();
+        }
+
+        // A batch counts as solved when every rollout is, with the length of
+        // the longest one.
+        bool Add(const EvaluationSummary &summary) {
+            EvaluationResult result;
+            result.Solved = summary.AllSolved();
+            result.Steps = summary.MaxSteps;
+            return Add(result);
+        }
+
+        explicit ConvergenceMonitor(const std::size_t &required)
+            : Required(required), _streak(0), _length(0) {}
+    };
+}  // namespace SokobanQLearning
+
+#endif  // SokobanQLearning_Evaluation_HPP_
@@ -0,0 +1,153 @@
+#ifndef SokobanQLearning_ExperienceReplay_HPP_
+#define SokobanQLearning_ExperienceReplay_HPP_ 1
+
+#include "./Sokoban.hpp"
+#include "./SokobanQLearning.hpp"
+#include "./Utils.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace SokobanQLearning {
+    template <class RealType, std::size_t StateBits>
+    class ReplayBuffer {
+    public:
+        typedef Transition<RealType, StateBits> TransitionType;
+
+    protected:
+        std::vector<TransitionType> _buffer;
+        std::size_t _capacity, _next;
+
+    public:
+        std::size_t Size() const { return _buffer.size(); }
+
+        std::size_t Capacity() const { return _capacity; }
+
+        bool Empty() const { return _buffer.empty(); }
+
+        const TransitionType &operator[](const std::size_t &index) const {
+            return _buffer[index];
+        }
+
+        void Clear() {
+            _buffer.clear();
+            _next = 0;
+        }
+
+        // Overwrites the oldest record once the buffer is full.
+        void Add(const TransitionType &transition) {
+            if (!_capacity) return;
+            if (_buffer.size() < _capacity)
+                _buffer.push_back(transition);
+            else
+                _buffer[_next] = transition;
+            if (++_next == _capacity) _next = 0;
+        }
+
+        template <class URNG>
+        const TransitionType &Sample(URNG &random_generator) const {
+            return _buffer[Utils::UniformInt(random_generator, _buffer.size())];
+        }
+
+        // Draws `count` records uniformly with replacement into `batch`.
+        template <class URNG>
+        void Sample(URNG &random_generator, const std::size_t &count,
+                    std::vector<const TransitionType *> &batch) const {
+            batch.clear();
+            if (_buffer.empty()) return;
+            for (std::size_t i = 0; i < count; ++i)
+                batch.push_back(&_buffer[Utils::UniformInt(
+                    random_generator, _buffer.size())]);
+        }
+
+        explicit ReplayBuffer(const std::size_t &capacity)
+            : _capacity(capacity), _next(0) {
+            _buffer.reserve(capacity);
+        }
+    };
+
+    // Takes one environment step like Train, stores the transition, and then
+    // replays `replay_ratio` transitions sampled uniformly from the buffer.
+    template <class URNG, class RealType, std::size_t StateBits>
+    TrainResult<RealType, StateBits> TrainReplay(
+        URNG &random_generator, Sokoban::Game<StateBits> &game,
+        IQTable<RealType, StateBits> &Q,
+        ReplayBuffer<RealType, StateBits> &buffer,
+        const std::size_t &replay_ratio, const TrainParams<RealType> &params) {
+        const auto last_state = game.GetState();
+        const auto old_row = Q.Get(last_state);
+        if (game.GetSucceeded() || game.GetFailed()) {
+            game.Restart();
+            return {last_state, old_row};
+        }
+        const auto &transition = Act(
+            game, FindAction(random_generator, params.Epsilon, game, Q),
+            params);
+        const auto min_Q = params.MinQ(game.GetBoxPos0().size());
+        Backup(Q, transition, params.Alpha, params.Gamma, min_Q);
+        buffer.Add(transition);
+        for (std::size_t i = 0; i < replay_ratio; ++i)
+            Backup(Q, buffer.Sample(random_generator), params.Alpha,
+                   params.Gamma, min_Q);
+        return {transition, old_row, Q.Get(last_state)};
+    }
+
+    // The transitions of the current episode, kept across episodes so the
+    // storage is reused.
+    template <class RealType, std::size_t StateBits>
+    class EpisodeBuffer {
+    public:
+        typedef Transition<RealType, StateBits> TransitionType;
+
+    protected:
+        std::vector<TransitionType> _buffer;
+
+    public:
+        std::size_t Size() const { return _buffer.size(); }
+
+        void Clear() { _buffer.clear(); }
+
+        void Add(const TransitionType &transition) {
+            _buffer.push_back(transition);
+        }
+
+        // Backs up every transition but the last, latest first, so a value
+        // learned at the end of the episode reaches its start in one pass.
+        void ReplayBackward(IQTable<RealType, StateBits> &Q,
+                            const RealType &alpha, const RealType &gamma,
+                            const RealType &min_Q) const {
+            for (auto i = _buffer.size(); i-- > 1;)
+                Backup(Q, _buffer[i - 1], alpha, gamma, min_Q);
+        }
+    };
+
+    // Takes one environment step like Train and records the transition.
+    // Once the episode succeeds, it is replayed backward (see
+    // EpisodeBuffer::ReplayBackward); a new episode starts the record over.
+    template <class URNG, class RealType, std::size_t StateBits>
+    TrainResult<RealType, StateBits> TrainBackward(
+        URNG &random_generator, Sokoban::Game<StateBits> &game,
+        IQTable<RealType, StateBits> &Q,
+        EpisodeBuffer<RealType, StateBits> &episode,
+        const TrainParams<RealType> &params) {
+        const auto last_state = game.GetState();
+        const auto old_row = Q.Get(last_state);
+        if (game.GetSucceeded() || game.GetFailed()) {
+            game.Restart();
+            episode.Clear();
+            return {last_state, old_row};
+        }
+        if (!game.GetTimeElapsed()) episode.Clear();
+        const auto &transition = Act(
+            game, FindAction(random_generator, params.Epsilon, game, Q),
+            params);
+        const auto min_Q = params.MinQ(game.GetBoxPos0().size());
+        Backup(Q, transition, params.Alpha, params.Gamma, min_Q);
+        episode.Add(transition);
+        if (game.GetSucceeded())
+            episode.ReplayBackward(Q, params.Alpha, params.Gamma, min_Q);
+        return {transition, old_row, Q.Get(last_state)};
+    }
+}  // namespace SokobanQLearning
+
+#endif  // SokobanQLearning_ExperienceReplay_HPP_
@@ -0,0 +1,231 @@
+#ifndef SokobanQLearning_LinearQFunction_HPP_
+#define SokobanQLearning_LinearQFunction_HPP_ 1
+
+#include "./Sokoban.hpp"
+#include "./SokobanQLearning.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace SokobanQLearning {
+    template <class RealType>
+    void AddRow(std::array<RealType, 4> &sum,
+                const std::array<RealType, 4> &row) {
+        for (int i = 0; i < 4; ++i) sum[i] += row[i];
+    }
+
+#ifdef SokobanQLearning_USE_SSE_
+    inline void AddRow(std::array<float, 4> &sum,
+                       const std::array<float, 4> &row) {
+        _mm_storeu_ps(sum.data(), _mm_add_ps(_mm_loadu_ps(sum.data()),
+                                             _mm_loadu_ps(row.data())));
+    }
+#endif
+
+    // Approximates Q(s, a) as the sum of the weights of the binary features
+    // active in s, with one weight per action for every feature. The four
+    // weights of a feature are stored next to each other, so a row of Q is
+    // a sum of 4-lane vectors. The features of a state are
+    // - a bias, and the player's cell;
+    // - the 3x3 neighbourhood of the player and of every box, each cell
+    //   being a wall, a floor, a goal or a box;
+    // - how many pushes every box is from a goal, capped at 15, alone and
+    //   with the sides of the box the player can walk to.
+    // Features are hashed into 2^FeatureBits buckets, so memory does not
+    // depend on the number of states, and states that look alike around
+    // the boxes share values.
+    //
+    // Set moves Q(s, a) all the way to the given value by spreading the
+    // difference evenly over the features of s; the learning rate of Backup
+    // then acts as the step size of semi-gradient descent. There are no rows
+    // to enumerate, so ForEach does nothing and Check is always true. Get
+    // caches the features of the last state, so even reads must not be made
+    // concurrently.
+    template <class RealType, std::size_t StateBits>
+    class LinearQFunction : public IQTable<RealType, StateBits> {
+    public:
+        using typename IQTable<RealType, StateBits>::StateType;
+        using typename IQTable<RealType, StateBits>::RowType;
+        typedef std::uint_least32_t FeatureType;
+
+    protected:
+        enum FeatureKind : std::uint_least64_t {
+            Bias,
+            PlayerCell,
+            PlayerPattern,
+            BoxPattern,
+            BoxDistance,
+            BoxSides
+        };
+
+        // Floor index of the neighbour of every floor cell in every
+        // direction, -1 for a wall, and the cell codes around it.
+        std::vector<std::array<Sokoban::SizeInt, 4>> _neighbours;
+        std::vector<std::array<Sokoban::SizeInt, 8>> _ring;
+        std::vector<std::uint_least8_t> _goal;
+        std::vector<Sokoban::SizeInt> _distance;
+        Sokoban::BitsInt _floor_bits;
+        std::size_t _box_count;
+        unsigned _shift;
+        std::vector<RowType> _weights;
+
+        mutable StateType _cached_state;
+        mutable bool _cached;
+        mutable std::vector<FeatureType> _features;
+        mutable std::vector<std::uint_least8_t> _box, _reached;
+        mutable std::vector<Sokoban::SizeInt> _region, _boxes;
+
+        FeatureType Hash(const FeatureKind &kind,
+                         const std::uint_least64_t &value) const {
+            return static_cast<FeatureType>(
+                ((kind << 56) ^ value) * UINT64_C(0x9E3779B97F4A7C15) >>
+                _shift);
+        }
+
+        // 2 bits per cell: wall, floor, goal or box.
+        std::uint_least64_t Pattern(const Sokoban::SizeInt &cell) const {
+            std::uint_least64_t pattern = _goal[cell];
+            for (const auto &c : _ring[cell])
+                pattern = pattern << 2 |
+                          (c < 0 ? 0 : _box[c] ? 3 : _goal[c] ? 2 : 1);
+            return pattern;
+        }
+
+        const std::vector<FeatureType> &Features(
+            const StateType &state) const {
+            if (_cached && state == _cached_state) return _features;
+            const StateType mask((1ull << _floor_bits) - 1);
+            const auto player =
+                static_cast<Sokoban::SizeInt>((state & mask).to_ullong());
+            _boxes.clear();
+            for (std::size_t i = 1; i <= _box_count; ++i) {
+                _boxes.push_back(static_cast<Sokoban::SizeInt>(
+                    ((state >> _floor_bits * i) & mask).to_ullong()));
+                _box[_boxes.back()] = 1;
+            }
+            _reached[player] = 1;
+            _region.assign(1, player);
+            for (std::size_t i = 0; i < _region.size(); ++i)
+                for (const auto &n : _neighbours[_region[i]])
+                    if (n >= 0 && !_box[n] && !_reached[n]) {
+                        _reached[n] = 1;
+                        _region.push_back(n);
+                    }
+            _features.clear();
+            _features.push_back(Hash(Bias, 0));
+            _features.push_back(Hash(PlayerCell, player));
+            _features.push_back(Hash(PlayerPattern, Pattern(player)));
+            for (const auto &b : _boxes) {
+                const std::uint_least64_t distance =
+                    _distance[b] < 0 ? 16 : std::min<Sokoban::SizeInt>(
+                                                _distance[b], 15);
+                std::uint_least64_t sides = 0;
+                for (const auto &n : _neighbours[b])
+                    sides = sides << 1 | (n >= 0 && _reached[n]);
+                _features.push_back(Hash(BoxPattern, Pattern(b)));
+                _features.push_back(Hash(BoxDistance, distance));
+                _features.push_back(Hash(BoxSides, sides << 5 | distance));
+            }
+            for (const auto &b : _boxes) _box[b] = 0;
+            for (const auto &r : _region) _reached[r] = 0;
+            std::sort(_features.begin(), _features.end());
+            _features.erase(std::unique(_features.begin(), _features.end()),
+                            _features.end());
+            _cached_state = state;
+            _cached = true;
+            return _features;
+        }
+
+    public:
+        std::size_t FeatureCount() const { return _weights.size(); }
+
+        void Clear() {
+            std::fill(_weights.begin(), _weights.end(), RowType{{0, 0, 0, 0}});
+        }
+
+        RealType Get(const StateType &state,
+                     const Sokoban::DirectionInt &action) const override {
+            const auto index = Sokoban::DirectionIndex(action);
+            return index < 0 ? 0 : Get(state)[index];
+        }
+
+        RowType Get(const StateType &state) const override {
+            RowType row{{0, 0, 0, 0}};
+            for (const auto &f : Features(state)) AddRow(row, _weights[f]);
+            return row;
+        }
+
+        void Set(const StateType &state, const Sokoban::DirectionInt &action,
+                 const RealType &value) override {
+            const auto index = Sokoban::DirectionIndex(action);
+            if (index < 0) return;
+            RowType row = Get(state);
+            row[index] = value;
+            Set(state, row);
+        }
+
+        void Set(const StateType &state, const RowType &row) override {
+            RowType step = Get(state);
+            const auto &features = Features(state);
+            for (int i = 0; i < 4; ++i)
+                step[i] = (row[i] - step[i]) / features.size();
+            for (const auto &f : features) AddRow(_weights[f], step);
+        }
+
+        bool Check(const StateType &) const override { return true; }
+
+        void ForEach(
+            const std::function<void(const StateType &, const RowType &)> &)
+            const override {}
+
+        // Precomputes the level's geometry, so the approximator only works
+        // with states of levels laid out like `game`.
+        LinearQFunction(const Sokoban::Game<StateBits> &game,
+                        const unsigned &feature_bits)
+            : _floor_bits(game.GetFloorBits()),
+              _box_count(game.GetBoxPos0().size()),
+              _shift(64 - std::min(std::max(feature_bits, 1u), 32u)),
+              _weights(std::size_t(1) << (64 - _shift),
+                       RowType{{0, 0, 0, 0}}),
+              _cached(false) {
+            const auto &floor = game.GetFloorPos();
+            const auto &index = game.GetFloorIndex();
+            const auto at = [&](const int &line,
+                                const int &col) -> Sokoban::SizeInt {
+                return line < 0 || line >= game.GetHeight() || col < 0 ||
+                               col >= game.GetWidth()
+                           ? -1
+                           : index[line][col];
+            };
+            _neighbours.resize(floor.size());
+            _ring.resize(floor.size());
+            _goal.assign(floor.size(), 0);
+            for (std::size_t i = 0; i < floor.size(); ++i) {
+                const auto &p = floor[i];
+                int k = 0;
+                for (const auto &d : Sokoban::AllDirections) {
+                    const auto &m = Sokoban::Movement(d);
+                    _neighbours[i][k++] =
+                        at(p.first + m.first, p.second + m.second);
+                }
+                k = 0;
+                for (int line = -1; line <= 1; ++line)
+                    for (int col = -1; col <= 1; ++col)
+                        if (line || col)
+                            _ring[i][k++] =
+                                at(p.first + line, p.second + col);
+            }
+            for (const auto &g : game.GetGoalPos())
+                _goal[index[g.first][g.second]] = 1;
+            _distance = game.GetBoxDistance();
+            _box.assign(floor.size(), 0);
+            _reached.assign(floor.size(), 0);
+        }
+    };
+}  // namespace SokobanQLearning
+
+#endif  // SokobanQLearning_LinearQFunction_HPP_
@@ -0,0 +1,197 @@
+#ifndef SokobanQLearning_MultiStep_HPP_
+#define SokobanQLearning_MultiStep_HPP_ 1
+
+#include "./Sokoban.hpp"
+#include "./SokobanQLearning.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+namespace SokobanQLearning {
+    // Replacing eligibility traces of the current episode, oldest first.
+    // Every trace decays by the same factor each step, so the oldest one is
+    // always the smallest: truncation below Threshold and eviction beyond
+    // Capacity both drop a prefix.
+    template <class RealType, std::size_t StateBits>
+    class EligibilityTraces {
+    public:
+        typedef typename IQTable<RealType, StateBits>::StateType StateType;
+
+        struct Trace {
+            StateType State;
+            Sokoban::DirectionInt Action;
+            RealType Value;
+        };
+
+        RealType Lambda, Threshold;
+        std::size_t Capacity;
+
+    protected:
+        std::vector<Trace> _traces;
+
+    public:
+        std::size_t Size() const { return _traces.size(); }
+
+        const std::vector<Trace> &GetTraces() const { return _traces; }
+
+        void Clear() { _traces.clear(); }
+
+        void Visit(const StateType &state,
+                   const Sokoban::DirectionInt &action) {
+            _traces.erase(std::remove_if(_traces.begin(), _traces.end(),
+                                         [&state](const Trace &t) {
+                                             return t.State == state;
+                                         }),
+                          _traces.end());
+            if (!Capacity) return;
+            if (_traces.size() >= Capacity)
+                _traces.erase(_traces.begin(), _traces.end() - (Capacity - 1));
+            _traces.push_back({state, action, 1});
+        }
+
+        void Update(IQTable<RealType, StateBits> &Q, const RealType &alpha,
+                    const RealType &delta) const {
+            for (const auto &t : _traces)
+                Q.Set(t.State, t.Action,
+                      Q.Get(t.State, t.Action) + alpha * delta * t.Value);
+        }
+
+        void Decay(const RealType &gamma) {
+            const RealType factor = gamma * Lambda;
+            for (auto &t : _traces) t.Value *= factor;
+            const auto &first = std::find_if(
+                _traces.begin(), _traces.end(),
+                [this](const Trace &t) { return t.Value >= Threshold; });
+            _traces.erase(_traces.begin(), first);
+        }
+
+        explicit EligibilityTraces(const RealType &lambda,
+                                   const RealType &threshold = 0.01,
+                                   const std::size_t &capacity = 1024)
+            : Lambda(lambda), Threshold(threshold), Capacity(capacity) {
+            _traces.reserve(Capacity);
+        }
+    };
+
+    // Watkins's Q(lambda): the TD error of each step is applied to every
+    // traced pair, and the traces are cut whenever an exploratory action is
+    // taken or the episode ends.
+    template <class URNG, class RealType, std::size_t StateBits>
+    TrainResult<RealType, StateBits> TrainLambda(
+        URNG &random_generator, Sokoban::Game<StateBits> &game,
+        IQTable<RealType, StateBits> &Q,
+        EligibilityTraces<RealType, StateBits> &traces,
+        const TrainParams<RealType> &params) {
+        const auto last_state = game.GetState();
+        const auto old_row = Q.Get(last_state);
+        if (game.GetSucceeded() || game.GetFailed()) {
+            traces.Clear();
+            game.Restart();
+            return {last_state, old_row};
+        }
+        const auto action =
+            FindAction(random_generator, params.Epsilon, game, Q);
+        const auto last_Q = Q.Get(last_state, action);
+        if (last_Q < MaxQ(Q, last_state, game.GetDirections(),
+                          std::numeric_limits<RealType>::lowest()))
+            traces.Clear();
+        traces.Visit(last_state, action);
+        const auto &transition = Act(game, action, params);
+        const auto delta =
+            transition.Reward +
+            params.Gamma * MaxQ(Q, transition.State, transition.Directions,
+                                params.MinQ(game.GetBoxPos0().size())) -
+            last_Q;
+        traces.Update(Q, params.Alpha, delta);
+        if (transition.Done)
+            traces.Clear();
+        else
+            traces.Decay(params.Gamma);
+        return {transition, old_row, Q.Get(last_state)};
+    }
+
+    // The last N transitions of the current episode, oldest first.
+    template <class RealType, std::size_t StateBits>
+    class NStepWindow {
+    public:
+        typedef Transition<RealType, StateBits> TransitionType;
+
+    protected:
+        std::vector<TransitionType> _window;
+        std::size_t _first, _size;
+
+        const TransitionType &At(const std::size_t &index) const {
+            return _window[(_first + index) % _window.size()];
+        }
+
+    public:
+        std::size_t N() const { return _window.size(); }
+
+        std::size_t Size() const { return _size; }
+
+        bool Full() const { return _size == _window.size(); }
+
+        void Clear() { _first = _size = 0; }
+
+        void Push(const TransitionType &transition) {
+            _window[(_first + _size) % _window.size()] = transition;
+            ++_size;
+        }
+
+        // Moves the oldest pair toward its discounted return over the whole
+        // window, bootstrapped from the state the newest transition reached,
+        // and drops it.
+        void Update(IQTable<RealType, StateBits> &Q, const RealType &alpha,
+                    const RealType &gamma, const RealType &min_Q) {
+            const auto &last = At(_size - 1);
+            RealType target = MaxQ(Q, last.State, last.Directions, min_Q);
+            for (std::size_t i = _size; i--;)
+                target = At(i).Reward + gamma * target;
+            const auto &oldest = At(0);
+            Q.Set(oldest.LastState, oldest.Action,
+                  (static_cast<RealType>(1) - alpha) *
+                          Q.Get(oldest.LastState, oldest.Action) +
+                      alpha * target);
+            _first = (_first + 1) % _window.size();
+            --_size;
+        }
+
+        explicit NStepWindow(const std::size_t &n)
+            : _window(std::max(n, static_cast<std::size_t>(1))),
+              _first(0),
+              _size(0) {}
+    };
+
+    // n-step Q-learning: a pair is updated once n more steps have been
+    // taken, and the pairs still in the window are updated with truncated
+    // returns when the episode ends.
+    template <class URNG, class RealType, std::size_t StateBits>
+    TrainResult<RealType, StateBits> TrainNStep(
+        URNG &random_generator, Sokoban::Game<StateBits> &game,
+        IQTable<RealType, StateBits> &Q,
+        NStepWindow<RealType, StateBits> &window,
+        const TrainParams<RealType> &params) {
+        const auto last_state = game.GetState();
+        const auto old_row = Q.Get(last_state);
+        if (game.GetSucceeded() || game.GetFailed()) {
+            window.Clear();
+            game.Restart();
+            return {last_state, old_row};
+        }
+        const auto &transition = Act(
+            game, FindAction(random_generator, params.Epsilon, game, Q),
+            params);
+        const auto min_Q = params.MinQ(game.GetBoxPos0().size());
+        window.Push(transition);
+        if (window.Full())
+            window.Update(Q, params.Alpha, params.Gamma, min_Q);
+        if (transition.Done)
+            while (window.Size())
+                window.Update(Q, params.Alpha, params.Gamma, min_Q);
+        return {transition, old_row, Q.Get(last_state)};
+    }
+}  // namespace SokobanQLearning
+
+#endif  // SokobanQLearning_MultiStep_HPP_
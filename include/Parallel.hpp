@@ -0,0 +1,236 @@
+#ifndef SokobanQLearning_Parallel_HPP_
+#define SokobanQLearning_Parallel_HPP_ 1
+
+#include "./Sokoban.hpp"
+#include "./SokobanQLearning.hpp"
+#include "./Utils.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace SokobanQLearning {
+    template <class Function>
+    void RunThreads(const std::size_t &thread_count, Function function) {
+        std::vector<std::exception_ptr> errors(thread_count);
+        std::vector<std::thread> threads;
+        threads.reserve(thread_count);
+        try {
+            for (std::size_t i = 0; i < thread_count; ++i)
+                threads.emplace_back([&errors, &function, i]() -> void {
+                    try {
+                        function(i);
+                    } catch (...) {
+                        errors[i] = std::current_exception();
+                    }
+                });
+        } catch (...) {
+            for (auto &t : threads) t.join();
+            throw;
+        }
+        for (auto &t : threads) t.join();
+        for (const auto &e : errors)
+            if (e) std::rethrow_exception(e);
+    }
+
+    // Runs `function(job, thread)` for every job in [0, job_count) on
+    // `thread_count` threads, handing out jobs one at a time.
+    template <class Function>
+    void ParallelFor(const std::size_t &thread_count,
+                     const std::size_t &job_count, Function function) {
+        std::atomic<std::size_t> next(0);
+        RunThreads(std::min(thread_count, job_count),
+                   [&next, &job_count, &function](
+                       const std::size_t &thread) -> void {
+                       for (std::size_t job;
+                            (job = next.fetch_add(
+                                 1, std::memory_order_relaxed)) < job_count;)
+                           function(job, thread);
+                   });
+    }
+
+    // Holds each of `count` threads in Wait until all of them have called
+    // it. The last thread to arrive runs `completion` before the others are
+    // released, so it may read and write what they produced and will read
+    // next. Reusable for any number of rounds.
+    class Barrier {
+    protected:
+        std::mutex _mutex;
+        std::condition_variable _condition;
+        std::size_t _count, _waiting, _round;
+
+    public:
+        template <class Function>
+        void Wait(Function completion) {
+            std::unique_lock<std::mutex> lock(_mutex);
+            const auto round = _round;
+            if (++_waiting < _count) {
+                _condition.wait(lock,
+                                [&]() -> bool { return round != _round; });
+                return;
+            }
+            completion();
+            _waiting = 0;
+            ++_round;
+            lock.unlock();
+            _condition.notify_all();
+        }
+
+        explicit Barrier(const std::size_t &count)
+            : _count(count), _waiting(0), _round(0) {}
+    };
+
+    struct ThreadStats {
+        Sokoban::TimeInt Steps = 0;
+        double Seconds = 0;
+
+        double StepsPerSecond() const {
+            return Seconds > 0 ? Steps / Seconds : 0;
+        }
+    };
+
+    struct ParallelTrainStats {
+        std::vector<ThreadStats> Threads;
+        double Seconds = 0;
+
+        Sokoban::TimeInt Steps() const {
+            Sokoban::TimeInt steps = 0;
+            for (const auto &t : Threads) steps += t.Steps;
+            return steps;
+        }
+
+        double StepsPerSecond() const {
+            return Seconds > 0 ? Steps() / Seconds : 0;
+        }
+
+        void Print(std::ostream &os, int precision, int column_width) const {
+            os << std::right << std::setfill(' ') << std::setw(column_width)
+               << "Thread" << std::setw(column_width) << "Steps"
+               << std::setw(column_width) << "Seconds"
+               << std::setw(column_width) << "Steps/s" << std::endl
+               << std::fixed << std::setprecision(precision);
+            for (std::size_t i = 0; i < Threads.size(); ++i)
+                os << std::setw(column_width) << i << std::setw(column_width)
+                   << Threads[i].Steps << std::setw(column_width)
+                   << Threads[i].Seconds << std::setw(column_width)
+                   << Threads[i].StepsPerSecond() << std::endl;
+            os << std::setw(column_width) << "Total" << std::setw(column_width)
+               << Steps() << std::setw(column_width) << Seconds
+               << std::setw(column_width) << StepsPerSecond() << std::endl;
+        }
+    };
+
+    // Runs one actor per thread, each owning a copy of `game` and the
+    // generator of seed stream 1 + its index (stream 0 is left to the
+    // caller), until `steps` steps have been taken
+    // in total or `stop` is set. `step(thread, random_generator, game)`
+    // performs a single training step.
+    template <class URNG, std::size_t StateBits, class StepFunction>
+    ParallelTrainStats RunActors(const Sokoban::Game<StateBits> &game,
+                                 const std::size_t &thread_count,
+                                 const Sokoban::TimeInt &steps,
+                                 const std::uint_least64_t &seed,
+                                 const std::atomic_bool &stop,
+                                 StepFunction step) {
+        ParallelTrainStats stats;
+        stats.Threads.resize(thread_count);
+        const auto start = std::chrono::steady_clock::now();
+        RunThreads(thread_count, [&](const std::size_t &index) -> void {
+            const Sokoban::TimeInt thread_steps =
+                steps / thread_count + (index < steps % thread_count);
+            Sokoban::TimeInt done = 0;
+            auto random_generator = Utils::SeedStream<URNG>(seed, index + 1);
+            auto actor = game;
+            actor.Restart();
+            const auto thread_start = std::chrono::steady_clock::now();
+            while (done < thread_steps &&
+                   !stop.load(std::memory_order_relaxed)) {
+                step(index, random_generator, actor);
+                ++done;
+            }
+            stats.Threads[index].Steps = done;
+            stats.Threads[index].Seconds =
+                std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - thread_start)
+                    .count();
+        });
+        stats.Seconds = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+        return stats;
+    }
+
+    // Trains on `thread_count` threads with `step(random_generator, game)`.
+    // It is called concurrently, so the value store it updates must be safe
+    // to share (see ConcurrentQTable).
+    template <class URNG, std::size_t StateBits, class StepFunction>
+    ParallelTrainStats TrainParallel(const Sokoban::Game<StateBits> &game,
+                                     const std::size_t &thread_count,
+                                     const Sokoban::TimeInt &steps,
+                                     const std::uint_least64_t &seed,
+                                     const std::atomic_bool &stop,
+                                     StepFunction step) {
+        return RunActors<URNG>(
+            game, thread_count, steps, seed, stop,
+            [&step](const std::size_t &, URNG &random_generator,
+                    Sokoban::Game<StateBits> &actor) -> void {
+                step(random_generator, actor);
+            });
+    }
+
+    // Trains a private copy of Q on every thread with
+    // `step(random_generator, game, Q)`, then sets each row of Q to the mean
+    // of the copies that hold it, summed in thread order. Nothing is shared
+    // while training, so unless `stop` is set, the result depends only on
+    // the seed and the thread count.
+    template <class URNG, class RealType, std::size_t StateBits,
+              class StepFunction>
+    ParallelTrainStats TrainIndependent(const Sokoban::Game<StateBits> &game,
+                                        const std::size_t &thread_count,
+                                        const Sokoban::TimeInt &steps,
+                                        const std::uint_least64_t &seed,
+                                        const std::atomic_bool &stop,
+                                        IQTable<RealType, StateBits> &Q,
+                                        StepFunction step) {
+        typedef typename IQTable<RealType, StateBits>::StateType StateType;
+        typedef typename IQTable<RealType, StateBits>::RowType RowType;
+        std::vector<QTable<RealType, StateBits>> tables(thread_count);
+        Q.ForEach([&tables](const StateType &state, const RowType &row) {
+            for (auto &t : tables) t.Set(state, row);
+        });
+        const auto &stats = RunActors<URNG>(
+            game, thread_count, steps, seed, stop,
+            [&tables, &step](const std::size_t &index,
+                             URNG &random_generator,
+                             Sokoban::Game<StateBits> &actor) -> void {
+                step(random_generator, actor, tables[index]);
+            });
+        std::unordered_map<StateType, std::pair<RowType, RealType>> sums;
+        for (const auto &t : tables)
+            t.ForEach([&sums](const StateType &state, const RowType &row) {
+                auto &sum = sums[state];
+                for (std::size_t i = 0; i < 4; ++i) sum.first[i] += row[i];
+                ++sum.second;
+            });
+        for (const auto &p : sums) {
+            RowType row;
+            for (std::size_t i = 0; i < 4; ++i)
+                row[i] = p.second.first[i] / p.second.second;
+            Q.Set(p.first, row);
+        }
+        return stats;
+    }
+}  // namespace SokobanQLearning
+
+#endif  // SokobanQLearning_Parallel_HPP_
@@ -0,0 +1,302 @@
+#ifndef SokobanQLearning_Planning_HPP_
+#define SokobanQLearning_Planning_HPP_ 1
+
+#include "./Sokoban.hpp"
+#include "./SokobanQLearning.hpp"
+#include "./Utils.hpp"
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <iomanip>
+#include <memory>
+#include <ostream>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace SokobanQLearning {
+    // Remembers the outcome of every (state, action) pair seen so far. The
+    // game is deterministic, so one observation determines the next state;
+    // the reward is the last one observed, since the retrace penalty depends
+    // on the episode history rather than on the state alone.
+    template <class RealType, std::size_t StateBits>
+    class TransitionModel {
+    public:
+        typedef Transition<RealType, StateBits> TransitionType;
+        typedef typename TransitionType::StateType StateType;
+        typedef std::pair<StateType, Sokoban::DirectionInt> PairType;
+
+    protected:
+        struct Row {
+            std::array<TransitionType, 4> Outcomes;
+            Sokoban::DirectionInt Known = Sokoban::NoDirection;
+        };
+
+        std::unordered_map<StateType, Row> _model;
+        std::unordered_map<StateType, std::vector<PairType>> _predecessors;
+        std::vector<PairType> _pairs, _empty;
+
+    public:
+        std::size_t Size() const { return _model.size(); }
+
+        std::size_t PairCount() const { return _pairs.size(); }
+
+        template <class URNG>
+        const PairType &Sample(URNG &random_generator) const {
+            return _pairs[Utils::UniformInt(random_generator, _pairs.size())];
+        }
+
+        // Returns whether the pair had not been seen before.
+        bool Add(const TransitionType &transition) {
+            auto &row = _model[transition.LastState];
+            row.Outcomes[Sokoban::DirectionIndex(transition.Action)] =
+                transition;
+            if (row.Known & transition.Action) return false;
+            row.Known |= transition.Action;
+            _pairs.emplace_back(transition.LastState, transition.Action);
+            _predecessors[transition.State].emplace_back(transition.LastState,
+                                                         transition.Action);
+            return true;
+        }
+
+        const TransitionType *Find(const StateType &state,
+                                   const Sokoban::DirectionInt &action) const {
+            const auto &row = _model.find(state);
+            if (row == _model.end() || !(row->second.Known & action))
+                return nullptr;
+            return &row->second.Outcomes[Sokoban::DirectionIndex(action)];
+        }
+
+        const std::vector<PairType> &Predecessors(
+            const StateType &state) const {
+            const auto &p = _predecessors.find(state);
+            return p == _predecessors.end() ? _empty : p->second;
+        }
+
+        void Clear() {
+            _model.clear();
+            _predecessors.clear();
+            _pairs.clear();
+        }
+    };
+
+    template <class RealType, std::size_t StateBits>
+    class PrioritizedSweeping {
+    public:
+        typedef TransitionModel<RealType, StateBits> ModelType;
+        typedef typename ModelType::StateType StateType;
+
+        // Pairs whose TD error does not exceed Threshold are not queued, and
+        // each Sweep performs at most Budget backups.
+        RealType Threshold;
+        std::size_t Budget;
+
+    protected:
+        struct Entry {
+            RealType Priority;
+            StateType State;
+            Sokoban::DirectionInt Action;
+
+            bool operator<(const Entry &other) const {
+                return Priority < other.Priority;
+            }
+        };
+
+        ModelType _model;
+        std::priority_queue<Entry> _queue;
+        std::unordered_map<StateType, std::array<RealType, 4>> _queued;
+
+        RealType Error(const IQTable<RealType, StateBits> &Q,
+                       const typename ModelType::TransitionType &transition,
+                       const RealType &gamma, const RealType &min_Q) const {
+            return std::abs(
+                transition.Reward +
+                gamma * MaxQ(Q, transition.State, transition.Directions,
+                             min_Q) -
+                Q.Get(transition.LastState, transition.Action));
+        }
+
+    public:
+        const ModelType &GetModel() const { return _model; }
+
+        std::size_t QueueSize() const { return _queue.size(); }
+
+        // Queues a pair unless it is already queued with a higher priority;
+        // the outdated entry is then skipped when it is popped.
+        void Push(const StateType &state, const Sokoban::DirectionInt &action,
+                  const RealType &priority) {
+            if (!(priority > Threshold)) return;
+            auto &queued = _queued[state][Sokoban::DirectionIndex(action)];
+            if (priority <= queued) return;
+            queued = priority;
+            _queue.push({priority, state, action});
+        }
+
+        void Observe(const IQTable<RealType, StateBits> &Q,
+                     const typename ModelType::TransitionType &transition,
+                     const RealType &gamma, const RealType &min_Q) {
+            _model.Add(transition);
+            Push(transition.LastState, transition.Action,
+                 Error(Q, transition, gamma, min_Q));
+        }
+
+        std::size_t Sweep(IQTable<RealType, StateBits> &Q,
+                          const RealType &alpha, const RealType &gamma,
+                          const RealType &min_Q) {
+            std::size_t backups = 0;
+            while (backups < Budget && !_queue.empty()) {
+                const auto entry = _queue.top();
+                _queue.pop();
+                auto &queued = _queued[entry.State]
+                                      [Sokoban::DirectionIndex(entry.Action)];
+                if (queued != entry.Priority) continue;
+                queued = 0;
+                Backup(Q, *_model.Find(entry.State, entry.Action), alpha,
+                       gamma, min_Q);
+                ++backups;
+                for (const auto &p : _model.Predecessors(entry.State))
+                    Push(p.first, p.second,
+                         Error(Q, *_model.Find(p.first, p.second), gamma,
+                               min_Q));
+            }
+            return backups;
+        }
+
+        void Clear() {
+            _model.Clear();
+            _queue = decltype(_queue)();
+            _queued.clear();
+        }
+
+        PrioritizedSweeping(const RealType &threshold,
+                            const std::size_t &budget)
+            : Threshold(threshold), Budget(budget) {}
+    };
+
+    // Takes one environment step, records it in the model and queues it by
+    // its TD error, then spends the sweeping budget on the queued pairs and
+    // their predecessors, highest priority first.
+    template <class URNG, class RealType, std::size_t StateBits>
+    TrainResult<RealType, StateBits> TrainPrioritized(
+        URNG &random_generator, Sokoban::Game<StateBits> &game,
+        IQTable<RealType, StateBits> &Q,
+        PrioritizedSweeping<RealType, StateBits> &sweeping,
+        const TrainParams<RealType> &params) {
+        const auto last_state = game.GetState();
+        const auto old_row = Q.Get(last_state);
+        if (game.GetSucceeded() || game.GetFailed()) {
+            game.Restart();
+            return {last_state, old_row};
+        }
+        const auto &transition = Act(
+            game, FindAction(random_generator, params.Epsilon, game, Q),
+            params);
+        const auto min_Q = params.MinQ(game.GetBoxPos0().size());
+        sweeping.Observe(Q, transition, params.Gamma, min_Q);
+        sweeping.Sweep(Q, params.Alpha, params.Gamma, min_Q);
+        return {transition, old_row, Q.Get(last_state)};
+    }
+
+    struct DynaStats {
+        Sokoban::TimeInt RealSteps = 0, PlanningUpdates = 0;
+        double RealSeconds = 0, SimulationSeconds = 0, UpdateSeconds = 0;
+
+        void Print(std::ostream &os, int precision) const {
+            os << std::fixed << std::setprecision(precision)
+               << "Real Steps: " << RealSteps << " (" << RealSeconds << "s)"
+               << std::endl
+               << "Planning Updates: " << PlanningUpdates << std::endl
+               << "Simulation: " << SimulationSeconds << "s" << std::endl
+               << "Update: " << UpdateSeconds << "s" << std::endl;
+        }
+    };
+
+    // After every real step, backs up Planning (state, action) pairs drawn
+    // uniformly from those visited so far. Their outcomes come from the
+    // cached model, or, with Resimulate, from replaying the action on a
+    // scratch game restored to the state, which sees no retrace penalty.
+    template <class RealType, std::size_t StateBits>
+    class DynaQ {
+    public:
+        typedef TransitionModel<RealType, StateBits> ModelType;
+
+        std::size_t Planning;
+        bool Resimulate;
+        DynaStats Stats;
+
+    protected:
+        ModelType _model;
+        std::vector<typename ModelType::TransitionType> _batch;
+        std::unique_ptr<Sokoban::Game<StateBits>> _scratch;
+
+    public:
+        const ModelType &GetModel() const { return _model; }
+
+        void Observe(const typename ModelType::TransitionType &transition) {
+            _model.Add(transition);
+        }
+
+        template <class URNG>
+        void Plan(URNG &random_generator, const Sokoban::Game<StateBits> &game,
+                  IQTable<RealType, StateBits> &Q,
+                  const TrainParams<RealType> &params) {
+            if (!Planning || !_model.PairCount()) return;
+            const auto start = std::chrono::steady_clock::now();
+            _batch.clear();
+            if (Resimulate && !_scratch)
+                _scratch.reset(new Sokoban::Game<StateBits>(game));
+            for (std::size_t i = 0; i < Planning; ++i) {
+                const auto &pair = _model.Sample(random_generator);
+                if (Resimulate) {
+                    _scratch->Restore(pair.first);
+                    _batch.push_back(Act(*_scratch, pair.second, params));
+                } else
+                    _batch.push_back(*_model.Find(pair.first, pair.second));
+            }
+            const auto simulated = std::chrono::steady_clock::now();
+            const auto min_Q = params.MinQ(game.GetBoxPos0().size());
+            for (const auto &transition : _batch)
+                Backup(Q, transition, params.Alpha, params.Gamma, min_Q);
+            const auto updated = std::chrono::steady_clock::now();
+            Stats.PlanningUpdates += _batch.size();
+            Stats.SimulationSeconds +=
+                std::chrono::duration<double>(simulated - start).count();
+            Stats.UpdateSeconds +=
+                std::chrono::duration<double>(updated - simulated).count();
+        }
+
+        DynaQ(const std::size_t &planning, bool resimulate)
+            : Planning(planning), Resimulate(resimulate) {}
+    };
+
+    template <class URNG, class RealType, std::size_t StateBits>
+    TrainResult<RealType, StateBits> TrainDyna(
+        URNG &random_generator, Sokoban::Game<StateBits> &game,
+        IQTable<RealType, StateBits> &Q, DynaQ<RealType, StateBits> &dyna,
+        const TrainParams<RealType> &params) {
+        const auto last_state = game.GetState();
+        const auto old_row = Q.Get(last_state);
+        if (game.GetSucceeded() || game.GetFailed()) {
+            game.Restart();
+            return {last_state, old_row};
+        }
+        const auto start = std::chrono::steady_clock::now();
+        const auto &transition = Act(
+            game, FindAction(random_generator, params.Epsilon, game, Q),
+            params);
+        Backup(Q, transition, params.Alpha, params.Gamma,
+               params.MinQ(game.GetBoxPos0().size()));
+        dyna.Observe(transition);
+        ++dyna.Stats.RealSteps;
+        dyna.Stats.RealSeconds += std::chrono::duration<double>(
+                                      std::chrono::steady_clock::now() - start)
+                                      .count();
+        dyna.Plan(random_generator, game, Q, params);
+        return {transition, old_row, Q.Get(last_state)};
+    }
+}  // namespace SokobanQLearning
+
+#endif  // SokobanQLearning_Planning_HPP_
@@ -0,0 +1,196 @@
+#ifndef SokobanQLearning_PopulationTraining_HPP_
+#define SokobanQLearning_PopulationTraining_HPP_ 1
+
+#include "./Evaluation.hpp"
+#include "./Parallel.hpp"
+#include "./Sokoban.hpp"
+#include "./SokobanQLearning.hpp"
+#include "./Utils.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <vector>
+
+namespace SokobanQLearning {
+    // Scales epsilon, alpha, the push and goal rewards and the shaping weight
+    // each by 1 + perturbation or 1 - perturbation, chosen at random.
+    // Epsilon and alpha are kept within [0, 1].
+    template <class URNG, class RealType>
+    void PerturbParams(URNG &random_generator, TrainParams<RealType> &params,
+                       const double &perturbation) {
+        const auto factor = [&]() -> double {
+            return Utils::UniformInt(random_generator, 2) ? 1 + perturbation
+                                                          : 1 - perturbation;
+        };
+        params.Epsilon =
+            std::min(1.0, std::max(0.0, params.Epsilon * factor()));
+        params.Alpha = static_cast<RealType>(
+            std::min(1.0, std::max(0.0, params.Alpha * factor())));
+        params.Rewards.PushReward *= static_cast<RealType>(factor());
+        params.Rewards.GoalReward *= static_cast<RealType>(factor());
+        params.Rewards.Shaping *= static_cast<RealType>(factor());
+    }
+
+    // Population-based training: every member trains its own FlatQTable with
+    // its own parameters, all members in parallel. After each round of
+    // training, every member is evaluated greedily, and the worst Fraction of
+    // the population copies the table and parameters of a random member of
+    // the best Fraction, then perturbs the parameters (see PerturbParams).
+    // A member that solves the level scores minus its solution length, and
+    // one that does not scores below any that does.
+    template <class URNG, class RealType, std::size_t StateBits>
+    class PopulationTraining {
+    public:
+        typedef Sokoban::Game<StateBits> GameType;
+
+        struct Member {
+            TrainParams<RealType> Params;
+            FlatQTable<RealType, StateBits> Q;
+            GameType Actor;
+            URNG Random;
+            EvaluationResult Greedy;
+            // Steps trained by this member and the members it copied.
+            Sokoban::TimeInt Steps;
+            // Times this member copied another one.
+            std::size_t Exploits;
+        };
+
+        double Fraction, Perturbation;
+        Sokoban::TimeInt MaxSteps;
+
+    protected:
+        GameType _game;
+        std::vector<Member> _members;
+        URNG _random;
+        std::size_t _rounds;
+
+        std::int_least64_t Score(const Member &member) const {
+            return -static_cast<std::int_least64_t>(
+                member.Greedy.Solved ? member.Greedy.Steps : MaxSteps + 1);
+        }
+
+    public:
+        const std::vector<Member> &GetMembers() const { return _members; }
+
+        const std::size_t &GetRounds() const { return _rounds; }
+
+        // The best member of the last evaluation, the first one on ties.
+        const Member &Best() const {
+            return *std::max_element(
+                _members.begin(), _members.end(),
+                [this](const Member &a, const Member &b) -> bool {
+                    return Score(a) < Score(b);
+                });
+        }
+
+        // Trains every member for `steps` more steps on `thread_count`
+        // threads, then evaluates it.
+        void Train(const Sokoban::TimeInt &steps,
+                   const std::size_t &thread_count,
+                   const std::atomic_bool &stop) {
+            ParallelFor(
+                thread_count, _members.size(),
+                [&](const std::size_t &job, const std::size_t &) -> void {
+                    auto &member = _members[job];
+                    for (Sokoban::TimeInt i = 0;
+                         i < steps && !stop.load(std::memory_order_relaxed);
+                         ++i, ++member.Steps)
+                        TrainLean(member.Random, member.Actor, member.Q,
+                                  member.Params);
+                    member.Greedy =
+                        Evaluate(member.Random, _game, member.Q, 0, MaxSteps);
+                });
+            ++_rounds;
+        }
+
+        // Replaces the worst members by perturbed copies of the best ones,
+        // skipping any that score as well as the copy would. Returns how
+        // many were replaced.
+        std::size_t Exploit() {
+            const auto size = _members.size();
+            const auto count = std::min(
+                size / 2, static_cast<std::size_t>(std::ceil(size * Fraction)));
+            if (!count) return 0;
+            std::vector<std::size_t> order(size);
+            for (std::size_t i = 0; i < size; ++i) order[i] = i;
+            std::stable_sort(order.begin(), order.end(),
+                             [this](const std::size_t &a,
+                                    const std::size_t &b) -> bool {
+                                 return Score(_members[a]) >
+                                        Score(_members[b]);
+                             });
+            std::size_t replaced = 0;
+            for (std::size_t i = size - count; i < size; ++i) {
+                auto &member = _members[order[i]];
+                const auto &source =
+                    _members[order[Utils::UniformInt(_random, count)]];
+                if (Score(member) >= Score(source)) continue;
+                ++replaced;
+                member.Params = source.Params;
+                member.Q = source.Q;
+                member.Greedy = source.Greedy;
+                member.Steps = source.Steps;
+                ++member.Exploits;
+                member.Actor.Restart();
+                PerturbParams(_random, member.Params, Perturbation);
+            }
+            return replaced;
+        }
+
+        void Print(std::ostream &os, int precision) const {
+            os << std::right << std::setfill(' ') << std::setw(8) << "Member"
+               << std::setw(12) << "Epsilon" << std::setw(12) << "Alpha"
+               << std::setw(12) << "Push" << std::setw(12) << "Goal"
+               << std::setw(12) << "Shaping" << std::setw(10) << "Exploits"
+               << std::setw(10) << "Solution" << std::endl
+               << std::fixed << std::setprecision(precision);
+            for (std::size_t i = 0; i < _members.size(); ++i) {
+                const auto &member = _members[i];
+                const auto &params = member.Params;
+                os << std::setw(8) << i << std::setw(12) << params.Epsilon
+                   << std::setw(12) << params.Alpha << std::setw(12)
+                   << params.Rewards.PushReward << std::setw(12)
+                   << params.Rewards.GoalReward << std::setw(12)
+                   << params.Rewards.Shaping << std::setw(10)
+                   << member.Exploits << std::setw(10);
+                if (member.Greedy.Solved)
+                    os << member.Greedy.Steps << std::endl;
+                else
+                    os << "-" << std::endl;
+            }
+        }
+
+        // One member per configuration, member i drawing from seed stream
+        // i + 1 of `seed` and the exploit step from the stream after the
+        // last member's.
+        PopulationTraining(const GameType &game,
+                           const std::vector<TrainParams<RealType>> &configs,
+                           const std::uint_least64_t &seed,
+                           const double &fraction, const double &perturbation,
+                           const Sokoban::TimeInt &max_steps)
+            : Fraction(fraction),
+              Perturbation(perturbation),
+              MaxSteps(max_steps),
+              _game(game),
+              _random(Utils::SeedStream<URNG>(seed, configs.size() + 1)),
+              _rounds(0) {
+            _game.Restart();
+            _members.reserve(configs.size());
+            for (std::size_t i = 0; i < configs.size(); ++i)
+                _members.push_back({configs[i],
+                                    {},
+                                    _game,
+                                    Utils::SeedStream<URNG>(seed, i + 1),
+                                    {},
+                                    0,
+                                    0});
+        }
+    };
+}  // namespace SokobanQLearning
+
+#endif  // SokobanQLearning_PopulationTraining_HPP_
@@ -0,0 +1,412 @@
+#ifndef SokobanQLearning_QNetwork_HPP_
+#define SokobanQLearning_QNetwork_HPP_ 1
+
+#include "./ExperienceReplay.hpp"
+#include "./Sokoban.hpp"
+#include "./SokobanQLearning.hpp"
+#include "./Utils.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace SokobanQLearning {
+    // y += a * x for `n` values.
+    template <class RealType>
+    void Axpy(const std::size_t &n, const RealType &a, const RealType *x,
+              RealType *y) {
+        for (std::size_t i = 0; i < n; ++i) y[i] += a * x[i];
+    }
+
+    template <class RealType>
+    RealType Dot(const std::size_t &n, const RealType *x, const RealType *y) {
+        RealType sum = 0;
+        for (std::size_t i = 0; i < n; ++i) sum += x[i] * y[i];
+        return sum;
+    }
+
+#ifdef SokobanQLearning_USE_SSE_
+    // `n` must be a multiple of 4.
+    inline void Axpy(const std::size_t &n, const float &a, const float *x,
+                     float *y) {
+        const __m128 scale = _mm_set1_ps(a);
+        for (std::size_t i = 0; i < n; i += 4)
+            _mm_storeu_ps(y + i,
+                          _mm_add_ps(_mm_loadu_ps(y + i),
+                                     _mm_mul_ps(scale, _mm_loadu_ps(x + i))));
+    }
+
+    // `n` must be a multiple of 4.
+    inline float Dot(const std::size_t &n, const float *x, const float *y) {
+        __m128 sum = _mm_setzero_ps();
+        for (std::size_t i = 0; i < n; i += 4)
+            sum = _mm_add_ps(
+                sum, _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i)));
+        sum = _mm_add_ps(sum, _mm_shuffle_ps(sum, sum, 0b10110001));
+        sum = _mm_add_ps(sum, _mm_shuffle_ps(sum, sum, 0b01001110));
+        return _mm_cvtss_f32(sum);
+    }
+#endif
+
+    // C += A B, with A `rows` x `inner`, B `inner` x `cols` and C `rows` x
+    // `cols`, all row-major. Rows of C are updated four at a time, so every
+    // row of B is read from memory once per four rows and then from cache.
+    // Zeros of A, which make up most of a one-hot input, are skipped.
+    template <class RealType>
+    void Gemm(const std::size_t &rows, const std::size_t &inner,
+              const std::size_t &cols, const RealType *A, const RealType *B,
+              RealType *C) {
+        for (std::size_t r0 = 0; r0 < rows; r0 += 4) {
+            const auto r1 = std::min(rows, r0 + 4);
+            for (std::size_t k = 0; k < inner; ++k)
+                for (auto r = r0; r < r1; ++r)
+                    if (A[r * inner + k])
+                        Axpy(cols, A[r * inner + k], B + k * cols,
+                             C + r * cols);
+        }
+    }
+
+    // A multilayer perceptron approximating Q: the input has one plane per
+    // kind of object over the floor cells (player, boxes and goals), then
+    // two hidden layers of rectified linear units, then one output per
+    // action. Layer widths are rounded up to multiples of 4 for the SIMD
+    // kernels. Outputs are in units of Scale, and learned with the Huber
+    // loss, the error being clipped to Clip units.
+    //
+    // Predict runs a whole batch of states through the network at once,
+    // which is what keeps inference cheap when many environments are
+    // stepped together (see DeepQLearning). Set takes one gradient step
+    // towards the given values, so the network also works with Train and
+    // the other table-based algorithms. There are no rows to enumerate, so
+    // ForEach does nothing and Check is always true. The forward buffers are
+    // shared, so even reads must not be made concurrently.
+    template <class RealType, std::size_t StateBits>
+    class QNetwork : public IQTable<RealType, StateBits> {
+    public:
+        using typename IQTable<RealType, StateBits>::StateType;
+        using typename IQTable<RealType, StateBits>::RowType;
+
+        struct Layer {
+            std::size_t In, Out;
+            std::vector<RealType> Weights, Bias;
+        };
+
+        RealType LearningRate, Scale, Clip;
+
+    protected:
+        Sokoban::BitsInt _floor_bits;
+        std::size_t _floor_count, _box_count, _input_size;
+        std::vector<Sokoban::SizeInt> _goals;
+        std::vector<Layer> _layers, _target;
+        mutable std::vector<std::vector<RealType>> _activations;
+        std::vector<std::vector<RealType>> _gradients;
+
+        static std::size_t Round(const std::size_t &size) {
+            return (size + 3) & ~static_cast<std::size_t>(3);
+        }
+
+        void Encode(const StateType &state, RealType *input) const {
+            std::fill(input, input + _input_size, static_cast<RealType>(0));
+            const StateType mask((1ull << _floor_bits) - 1);
+            input[(state & mask).to_ullong()] = 1;
+            for (std::size_t i = 1; i <= _box_count; ++i)
+                input[_floor_count +
+                      ((state >> _floor_bits * i) & mask).to_ullong()] = 1;
+            for (const auto &g : _goals) input[2 * _floor_count + g] = 1;
+        }
+
+        // Runs the `count` inputs in _activations[0] through `layers`.
+        void Forward(const std::vector<Layer> &layers,
+                     const std::size_t &count) const {
+            for (std::size_t l = 0; l < layers.size(); ++l) {
+                const auto &layer = layers[l];
+                auto &out = _activations[l + 1];
+                out.resize(count * layer.Out);
+                for (std::size_t r = 0; r < count; ++r)
+                    std::copy(layer.Bias.begin(), layer.Bias.end(),
+                              out.begin() + r * layer.Out);
+                Gemm(count, layer.In, layer.Out, _activations[l].data(),
+                     layer.Weights.data(), out.data());
+                if (l + 1 < layers.size())
+                    for (auto &x : out)
+                        x = std::max(x, static_cast<RealType>(0));
+            }
+        }
+
+        void Load(const StateType *states, const std::size_t &count) const {
+            _activations[0].resize(count * _input_size);
+            for (std::size_t r = 0; r < count; ++r)
+                Encode(states[r], _activations[0].data() + r * _input_size);
+        }
+
+    public:
+        const std::vector<Layer> &GetLayers() const { return _layers; }
+
+        // Rows of Q for `count` states in one pass, from the target network
+        // if `target` is set.
+        void Predict(const StateType *states, const std::size_t &count,
+                     RowType *rows, bool target = false) const {
+            Load(states, count);
+            Forward(target ? _target : _layers, count);
+            const auto &out = _activations.back();
+            for (std::size_t r = 0; r < count; ++r)
+                for (std::size_t i = 0; i < 4; ++i)
+                    rows[r][i] = out[r * 4 + i] * Scale;
+        }
+
+        // One step of minibatch gradient descent on the Huber loss between
+        // Q(states[r], actions[r]) and targets[r].
+        void Learn(const StateType *states,
+                   const Sokoban::DirectionInt *actions,
+                   const RealType *targets, const std::size_t &count) {
+            if (!count) return;
+            Load(states, count);
+            Forward(_layers, count);
+            auto &delta = _gradients.back();
+            delta.assign(count * 4, 0);
+            for (std::size_t r = 0; r < count; ++r) {
+                const auto index = Sokoban::DirectionIndex(actions[r]);
+                if (index < 0) continue;
+                const RealType error =
+                    _activations.back()[r * 4 + index] - targets[r] / Scale;
+                delta[r * 4 + index] = std::max(-Clip, std::min(Clip, error));
+            }
+            const RealType step = -LearningRate / count;
+            for (auto l = _layers.size(); l--;) {
+                auto &layer = _layers[l];
+                const auto &in = _activations[l];
+                const auto &d = _gradients[l + 1];
+                if (l) {
+                    auto &d_in = _gradients[l];
+                    d_in.resize(count * layer.In);
+                    for (std::size_t r = 0; r < count; ++r)
+                        for (std::size_t k = 0; k < layer.In; ++k)
+                            d_in[r * layer.In + k] =
+                                in[r * layer.In + k] > 0
+                                    ? Dot(layer.Out, d.data() + r * layer.Out,
+                                          layer.Weights.data() + k * layer.Out)
+                                    : 0;
+                }
+                for (std::size_t r = 0; r < count; ++r) {
+                    for (std::size_t k = 0; k < layer.In; ++k)
+                        if (in[r * layer.In + k])
+                            Axpy(layer.Out, step * in[r * layer.In + k],
+                                 d.data() + r * layer.Out,
+                                 layer.Weights.data() + k * layer.Out);
+                    Axpy(layer.Out, step, d.data() + r * layer.Out,
+                         layer.Bias.data());
+                }
+            }
+        }
+
+        void SyncTarget() { _target = _layers; }
+
+        RealType Get(const StateType &state,
+                     const Sokoban::DirectionInt &action) const override {
+            const auto index = Sokoban::DirectionIndex(action);
+            return index < 0 ? 0 : Get(state)[index];
+        }
+
+        RowType Get(const StateType &state) const override {
+            RowType row;
+            Predict(&state, 1, &row);
+            return row;
+        }
+
+        void Set(const StateType &state, const Sokoban::DirectionInt &action,
+                 const RealType &value) override {
+            Learn(&state, &action, &value, 1);
+        }
+
+        void Set(const StateType &state, const RowType &row) override {
+            const StateType states[] = {state, state, state, state};
+            Learn(states, Sokoban::AllDirections.begin(), row.data(), 4);
+        }
+
+        bool Check(const StateType &) const override { return true; }
+
+        void ForEach(
+            const std::function<void(const StateType &, const RowType &)> &)
+            const override {}
+
+        // Hidden weights are drawn uniformly from +-sqrt(6 / fan-in), counting
+        // only the inputs that can be set at once for the first layer. The
+        // output weights start at 0, so like a table every value starts at
+        // 0, and the target network starts as a copy.
+        template <class URNG>
+        QNetwork(URNG &random_generator, const Sokoban::Game<StateBits> &game,
+                 const std::size_t &hidden, const RealType &learning_rate,
+                 const RealType &scale, const RealType &clip = 1)
+            : LearningRate(learning_rate),
+              Scale(scale),
+              Clip(clip),
+              _floor_bits(game.GetFloorBits()),
+              _floor_count(game.GetFloorPos().size()),
+              _box_count(game.GetBoxPos0().size()),
+              _input_size(Round(3 * _floor_count)) {
+            for (const auto &g : game.GetGoalPos())
+                _goals.push_back(game.GetFloorIndex()[g.first][g.second]);
+            const std::size_t width = Round(std::max(hidden, std::size_t(1)));
+            const std::size_t sizes[] = {_input_size, width, width, 4};
+            for (std::size_t l = 0; l < 3; ++l) {
+                Layer layer{sizes[l], sizes[l + 1], {}, {}};
+                const double fan_in =
+                    l ? layer.In : 1 + _box_count + _goals.size();
+                const double limit = std::sqrt(6 / fan_in);
+                layer.Weights.assign(layer.In * layer.Out, 0);
+                if (l < 2)
+                    for (auto &w : layer.Weights)
+                        w = static_cast<RealType>(
+                            (2 * Utils::UniformReal(random_generator) - 1) *
+                            limit);
+                layer.Bias.assign(layer.Out, 0);
+                _layers.push_back(std::move(layer));
+            }
+            _target = _layers;
+            _activations.resize(_layers.size() + 1);
+            _gradients.resize(_layers.size() + 1);
+        }
+    };
+
+    // Deep Q-learning on several copies of a level stepped in lockstep. Each
+    // step picks epsilon-greedy actions for all of them with one batched
+    // forward pass, stores every transition in a replay buffer, and then
+    // learns Updates minibatches of BatchSize transitions. Targets bootstrap
+    // as in double Q-learning: the online network picks the best next
+    // action and the target network values it, which keeps the maximum
+    // from feeding on its own overestimates. The target network is synced
+    // every SyncInterval minibatches.
+    template <class RealType, std::size_t StateBits>
+    class DeepQLearning {
+    public:
+        typedef Sokoban::Game<StateBits> GameType;
+        typedef typename GameType::StateType StateType;
+        typedef typename IQTable<RealType, StateBits>::RowType RowType;
+
+        std::size_t BatchSize, Updates, SyncInterval;
+
+    protected:
+        std::vector<GameType> _games;
+        ReplayBuffer<RealType, StateBits> _buffer;
+        std::size_t _learned;
+        std::vector<StateType> _states;
+        std::vector<RowType> _rows, _target_rows;
+        std::vector<Sokoban::DirectionInt> _actions;
+        std::vector<RealType> _targets;
+        std::vector<const Transition<RealType, StateBits> *> _batch;
+
+    public:
+        const std::vector<GameType> &GetGames() const { return _games; }
+
+        const ReplayBuffer<RealType, StateBits> &GetBuffer() const {
+            return _buffer;
+        }
+
+        // Steps the first `limit` environments once, all of them if there
+        // are fewer, then learns. Finished episodes are restarted straight
+        // away.
+        template <class URNG>
+        EpisodeStats Step(URNG &random_generator,
+                          QNetwork<RealType, StateBits> &Q,
+                          const TrainParams<RealType> &params,
+                          const std::size_t &limit) {
+            const auto start = std::chrono::steady_clock::now();
+            EpisodeStats stats;
+            const auto count = std::min(limit, _games.size());
+            _states.resize(count);
+            _rows.resize(count);
+            for (std::size_t i = 0; i < count; ++i)
+                _states[i] = _games[i].GetState();
+            Q.Predict(_states.data(), count, _rows.data());
+            for (std::size_t i = 0; i < count; ++i) {
+                auto &game = _games[i];
+                _buffer.Add(
+                    Act(game,
+                        ChooseAction(random_generator, params.Epsilon,
+                                     game.GetDirections(), _rows[i]),
+                        params));
+                ++stats.Steps;
+                const bool succeeded = game.GetSucceeded();
+                const bool failed = game.GetFailed();
+                if (succeeded || failed) {
+                    ++stats.Episodes;
+                    stats.Successes += succeeded;
+                    stats.Failures += failed;
+                    stats.EpisodeSteps += game.GetTimeElapsed();
+                    game.Restart();
+                }
+            }
+            const auto min_Q = params.MinQ(_games.front().GetBoxPos0().size());
+            for (std::size_t u = 0; u < Updates; ++u) {
+                _buffer.Sample(random_generator, BatchSize, _batch);
+                _states.resize(_batch.size());
+                _rows.resize(_batch.size());
+                _target_rows.resize(_batch.size());
+                _actions.resize(_batch.size());
+                _targets.resize(_batch.size());
+                for (std::size_t i = 0; i < _batch.size(); ++i)
+                    _states[i] = _batch[i]->State;
+                Q.Predict(_states.data(), _batch.size(), _rows.data());
+                Q.Predict(_states.data(), _batch.size(), _target_rows.data(),
+                          true);
+                for (std::size_t i = 0; i < _batch.size(); ++i) {
+                    const auto &t = *_batch[i];
+                    RealType next = t.Directions ? 0 : min_Q;
+                    if (t.Directions && !t.Done) {
+                        const auto &lanes =
+                            FindMaskedMax(_rows[i], t.Directions).Lanes;
+                        next = std::max(
+                            min_Q,
+                            _target_rows[i][Sokoban::DirectionIndex(
+                                lanes & -lanes)]);
+                    }
+                    _states[i] = t.LastState;
+                    _actions[i] = t.Action;
+                    _targets[i] = t.Reward + params.Gamma * next;
+                }
+                Q.Learn(_states.data(), _actions.data(), _targets.data(),
+                        _batch.size());
+                if (++_learned % SyncInterval == 0) Q.SyncTarget();
+            }
+            stats.Seconds = std::chrono::duration<double>(
+                                std::chrono::steady_clock::now() - start)
+                                .count();
+            return stats;
+        }
+
+        // Takes exactly `steps` environment steps, in rounds of Step.
+        template <class URNG>
+        EpisodeStats Run(URNG &random_generator,
+                         QNetwork<RealType, StateBits> &Q,
+                         const TrainParams<RealType> &params,
+                         const Sokoban::TimeInt &steps) {
+            EpisodeStats stats;
+            while (stats.Steps < steps)
+                stats += Step(random_generator, Q, params,
+                              std::min<Sokoban::TimeInt>(
+                                  steps - stats.Steps, _games.size()));
+            return stats;
+        }
+
+        DeepQLearning(const GameType &game, const std::size_t &environments,
+                      const std::size_t &capacity,
+                      const std::size_t &batch_size,
+                      const std::size_t &updates,
+                      const std::size_t &sync_interval)
+            : BatchSize(batch_size),
+              Updates(updates),
+              SyncInterval(std::max(sync_interval, std::size_t(1))),
+              _games(std::max(environments, std::size_t(1)), game),
+              _buffer(capacity),
+              _learned(0) {
+            for (auto &g : _games) g.Restart();
+        }
+    };
+}  // namespace SokobanQLearning
+
+#endif  // SokobanQLearning_QNetwork_HPP_
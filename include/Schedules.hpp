@@ -0,0 +1,152 @@
+#ifndef SokobanQLearning_Schedules_HPP_
+#define SokobanQLearning_Schedules_HPP_ 1
+
+#include "./Sokoban.hpp"
+#include "./SokobanQLearning.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace SokobanQLearning {
+    enum class ScheduleKind : std::uint_least8_t {
+        Constant,
+        Linear,
+        Exponential,
+        VisitCount
+    };
+
+    // Constant:    Start
+    // Linear:      Start to End over Duration time units, then End
+    // Exponential: Start * Rate ^ time, but not below End
+    // VisitCount:  Start / (1 + visits) ^ Rate, but not below End, where
+    //              visits counts the earlier steps taken from the same state
+    template <class RealType>
+    struct Schedule {
+        ScheduleKind Kind;
+        RealType Start, End, Rate;
+        Sokoban::TimeInt Duration;
+
+        RealType Value(const Sokoban::TimeInt &time,
+                       const Sokoban::TimeInt &visits) const {
+            switch (Kind) {
+                case ScheduleKind::Linear:
+                    return time >= Duration
+                               ? End
+                               : Start + (End - Start) * time / Duration;
+                case ScheduleKind::Exponential:
+                    return std::max(End, static_cast<RealType>(
+                                             Start * std::pow(Rate, time)));
+                case ScheduleKind::VisitCount:
+                    return std::max(
+                        End, static_cast<RealType>(
+                                 Start / std::pow(1 + visits, Rate)));
+                default:
+                    return Start;
+            }
+        }
+
+        Schedule(const RealType &value = 0)
+            : Kind(ScheduleKind::Constant),
+              Start(value),
+              End(value),
+              Rate(1),
+              Duration(0) {}
+        Schedule(const ScheduleKind &kind, const RealType &start,
+                 const RealType &end, const RealType &rate,
+                 const Sokoban::TimeInt &duration)
+            : Kind(kind),
+              Start(start),
+              End(end),
+              Rate(rate),
+              Duration(duration) {}
+    };
+
+    // Parses "<value>", "linear:<start>:<end>:<duration>",
+    // "exp:<start>:<end>:<rate>" or "visits:<start>:<end>:<power>".
+    template <class RealType>
+    Schedule<RealType> ParseSchedule(const std::string &spec) {
+        std::vector<std::string> fields;
+        std::string::size_type first = 0, last;
+        while ((last = spec.find(':', first)) != std::string::npos) {
+            fields.push_back(spec.substr(first, last - first));
+            first = last + 1;
+        }
+        fields.push_back(spec.substr(first));
+        if (fields.size() == 1) return Schedule<RealType>(std::stod(spec));
+        if (fields.size() != 4)
+            throw std::invalid_argument("Invalid Schedule: " + spec);
+        const RealType start = std::stod(fields[1]);
+        const RealType end = std::stod(fields[2]);
+        if (fields[0] == "linear")
+            return {ScheduleKind::Linear, start, end, 1,
+                    std::stoull(fields[3])};
+        const RealType rate = std::stod(fields[3]);
+        if (fields[0] == "exp")
+            return {ScheduleKind::Exponential, start, end, rate, 0};
+        if (fields[0] == "visits")
+            return {ScheduleKind::VisitCount, start, end, rate, 0};
+        throw std::invalid_argument("Invalid Schedule: " + spec);
+    }
+
+    // Produces the TrainParams of each step from the base parameters and the
+    // schedules of epsilon, alpha and the reward scale, which multiplies the
+    // intermediate push and goal rewards. Time is counted in steps, or in
+    // episodes with PerEpisode.
+    template <class RealType, std::size_t StateBits>
+    class Scheduler {
+    public:
+        typedef typename Sokoban::Game<StateBits>::StateType StateType;
+
+        Schedule<double> Epsilon, Alpha, RewardScale;
+        bool PerEpisode;
+
+    protected:
+        TrainParams<RealType> _base;
+        Sokoban::TimeInt _steps, _episodes;
+        std::unordered_map<StateType, Sokoban::TimeInt> _visits;
+
+    public:
+        const Sokoban::TimeInt &GetSteps() const { return _steps; }
+
+        const Sokoban::TimeInt &GetEpisodes() const { return _episodes; }
+
+        bool CountsVisits() const {
+            return Epsilon.Kind == ScheduleKind::VisitCount ||
+                   Alpha.Kind == ScheduleKind::VisitCount ||
+                   RewardScale.Kind == ScheduleKind::VisitCount;
+        }
+
+        // Call once before every step taken from `game`.
+        TrainParams<RealType> Next(const Sokoban::Game<StateBits> &game) {
+            if (game.GetSucceeded() || game.GetFailed()) ++_episodes;
+            const auto time = PerEpisode ? _episodes : _steps;
+            const Sokoban::TimeInt visits =
+                CountsVisits() ? _visits[game.GetState()]++ : 0;
+            ++_steps;
+            auto params = _base;
+            params.Epsilon = Epsilon.Value(time, visits);
+            params.Alpha = Alpha.Value(time, visits);
+            const RealType reward_scale = RewardScale.Value(time, visits);
+            params.Rewards.PushReward *= reward_scale;
+            params.Rewards.GoalReward *= reward_scale;
+            return params;
+        }
+
+        explicit Scheduler(const TrainParams<RealType> &base)
+            : Epsilon(base.Epsilon),
+              Alpha(base.Alpha),
+              RewardScale(1),
+              PerEpisode(false),
+              _base(base),
+              _steps(0),
+              _episodes(0) {}
+    };
+}  // namespace SokobanQLearning
+
+#endif  // SokobanQLearning_Schedules_HPP_
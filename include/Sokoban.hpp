@@ -55,6 +55,21 @@ namespace Sokoban {
         }
     }
 
+    constexpr int DirectionIndex(const DirectionInt &direction) {
+        switch (direction) {
+            case Up:
+                return 0;
+            case Left:
+                return 1;
+            case Right:
+                return 2;
+            case Down:
+                return 3;
+            default:
+                return -1;
+        }
+    }
+
     constexpr Pos Movement(const DirectionInt &direction) {
         switch (direction) {
             case Up:
@@ -87,6 +102,8 @@ namespace Sokoban {
         std::set<Pos> BoxPos0, BoxPos, GoalPos;
         std::vector<std::vector<PosInt>> Maze;
         std::vector<std::vector<SizeInt>> FloorIndex;
+        std::vector<Pos> FloorPos;
+        std::vector<SizeInt> BoxDistance;
         std::unordered_set<StateType> StateHistory;
 
         void UpdateData() {
@@ -248,6 +265,38 @@ namespace Sokoban {
             return false;
         }
 
+        // Fewest pushes taking a box from each floor cell to any goal if it
+        // were the only box, -1 if none can, by searching backwards from the
+        // goals: a box reaches p + d from p when the player stands at p - d.
+        void UpdateBoxDistance() {
+            BoxDistance.assign(FloorPos.size(), -1);
+            std::queue<Pos> cells;
+            for (const auto &g : GoalPos) {
+                BoxDistance[FloorIndex[g.first][g.second]] = 0;
+                cells.push(g);
+            }
+            while (!cells.empty()) {
+                const auto p = cells.front();
+                cells.pop();
+                const SizeInt distance =
+                    BoxDistance[FloorIndex[p.first][p.second]];
+                for (const auto &d : AllDirections) {
+                    const auto &movement = Movement(d);
+                    const Pos from(p.first - movement.first,
+                                   p.second - movement.second);
+                    if (!CheckFloor(from.first, from.second) ||
+                        !CheckFloor(from.first - movement.first,
+                                    from.second - movement.second))
+                        continue;
+                    auto &from_distance =
+                        BoxDistance[FloorIndex[from.first][from.second]];
+                    if (from_distance >= 0) continue;
+                    from_distance = distance + 1;
+                    cells.push(from);
+                }
+            }
+        }
+
         void DoRestart() {
             TimeElapsed = 0;
             StateHistory.clear();
@@ -256,6 +305,45 @@ namespace Sokoban {
             UpdateData();
         }
 
+        bool DoDecode(const StateType &state, Pos &player_pos,
+                      std::set<Pos> &box_pos) const {
+            const StateType mask((1ull << FloorBits) - 1);
+            const auto &player_index = (state & mask).to_ullong();
+            if (player_index >= FloorPos.size()) return false;
+            player_pos = FloorPos[player_index];
+            box_pos.clear();
+            for (std::size_t i = 1; i <= BoxPos0.size(); ++i) {
+                const auto &box_index =
+                    ((state >> FloorBits * i) & mask).to_ullong();
+                if (box_index >= FloorPos.size()) return false;
+                if (!box_pos.insert(FloorPos[box_index]).second) return false;
+            }
+            return !box_pos.count(player_pos);
+        }
+
+        void DoRestore(const StateType &state) {
+            Pos player_pos;
+            std::set<Pos> box_pos;
+            if (!DoDecode(state, player_pos, box_pos))
+                throw Error("Invalid State");
+            TimeElapsed = 0;
+            StateHistory.clear();
+            PlayerPos = player_pos;
+            BoxPos = std::move(box_pos);
+            UpdateData();
+        }
+
+        void DoSetStart(const Pos &player_pos, const std::set<Pos> &box_pos) {
+            if (box_pos.size() != BoxPos0.size() || box_pos.count(player_pos) ||
+                !CheckFloor(player_pos.first, player_pos.second))
+                throw Error("Invalid Start");
+            for (const auto &b : box_pos)
+                if (!CheckFloor(b.first, b.second))
+                    throw Error("Invalid Start");
+            PlayerPos0 = player_pos;
+            BoxPos0 = box_pos;
+        }
+
         bool DoMove(const DirectionInt &direction) {
             if (!(Directions & direction)) return false;
             const auto &movement = Movement(direction);
@@ -344,12 +432,29 @@ namespace Sokoban {
 
         const auto &GetFloorIndex() const { return FloorIndex; }
 
+        const auto &GetFloorPos() const { return FloorPos; }
+
+        const auto &GetBoxDistance() const { return BoxDistance; }
+
         const auto &GetStateHistory() const { return StateHistory; }
 
         std::string GetMazeString() const { return MazeString(); }
 
+        bool Decode(const StateType &state, Pos &player_pos,
+                    std::set<Pos> &box_pos) const {
+            return DoDecode(state, player_pos, box_pos);
+        }
+
         void Restart() { DoRestart(); }
 
+        // Puts the player and boxes where `state` says, as a fresh episode.
+        void Restore(const StateType &state) { DoRestore(state); }
+
+        // Changes where Restart puts the player and boxes.
+        void SetStart(const Pos &player_pos, const std::set<Pos> &box_pos) {
+            DoSetStart(player_pos, box_pos);
+        }
+
         bool Move(const DirectionInt &direction) { return DoMove(direction); }
 
         Game(std::string maze) {
@@ -424,8 +529,10 @@ namespace Sokoban {
             while (!floor.empty()) {
                 const auto &p = floor.front();
                 FloorIndex[p.first][p.second] = ++index;
+                FloorPos.push_back(p);
                 floor.pop();
             }
+            UpdateBoxDistance();
             DoRestart();
         }
     };
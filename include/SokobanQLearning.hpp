@@ -7,11 +7,28 @@
 #include <algorithm>
 #include <array>
 #include <bitset>
+#include <chrono>
+#include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <iomanip>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <ostream>
 #include <random>
+#include <stdexcept>
 #include <unordered_map>
+#include <vector>
+
+#undef SokobanQLearning_USE_SSE_
+
+#if (defined(__SSE2__) || defined(_M_X64)) && \
+    !defined(SokobanQLearning_NO_SSE_)
+#define SokobanQLearning_USE_SSE_
+#include <emmintrin.h>
+#endif
 
 namespace SokobanQLearning {
     template <class RealType, std::size_t StateBits>
@@ -19,6 +36,9 @@ namespace SokobanQLearning {
     public:
         typedef typename Sokoban::Game<StateBits>::StateType StateType;
         typedef std::array<RealType, 4> RowType;
+        static constexpr std::size_t FirstColumnWidth =
+            std::max(2 + (StateBits >> 2) + !!(StateBits & 0b11),
+                     static_cast<std::size_t>(6));
 
         virtual RealType Get(const StateType &state,
                              const Sokoban::DirectionInt &action) const = 0;
@@ -27,8 +47,47 @@ namespace SokobanQLearning {
                          const Sokoban::DirectionInt &action,
                          const RealType &value) = 0;
         virtual void Set(const StateType &state, const RowType &row) = 0;
+        // Moves Q(state, action) a fraction `alpha` of the way to `target`.
+        virtual void Blend(const StateType &state,
+                           const Sokoban::DirectionInt &action,
+                           const RealType &target, const RealType &alpha) {
+            Set(state, action,
+                (static_cast<RealType>(1) - alpha) * Get(state, action) +
+                    alpha * target);
+        }
         virtual bool Check(const StateType &state) const = 0;
+        virtual void ForEach(
+            const std::function<void(const StateType &, const RowType &)>
+                &function) const = 0;
         virtual ~IQTable() = default;
+
+        void PrintStateRow(std::ostream &os, int precision, int column_width,
+                           const StateType &state) const {
+            os << std::right << std::setfill(' ') << std::setw(FirstColumnWidth)
+               << "0x" + Utils::BitsToHex(state) << std::setprecision(precision)
+               << std::fixed;
+            for (const auto &value : Get(state))
+                os << std::setw(column_width) << value;
+            os << std::endl;
+        }
+
+        void PrintHeader(std::ostream &os, int column_width) const {
+            os << std::right << std::setfill(' ') << std::setw(FirstColumnWidth)
+               << "State";
+            for (const auto &d : Sokoban::AllDirections)
+                os << std::setw(column_width) << Sokoban::DirectionName(d);
+            os << std::endl;
+        }
+
+        void Print(std::ostream &os, int precision, int column_width) const {
+            os << std::string(FirstColumnWidth + 4 * column_width, '=')
+               << std::endl;
+            PrintHeader(os, column_width);
+            ForEach([&](const StateType &state, const RowType &) -> void {
+                PrintStateRow(os, precision, column_width, state);
+            });
+            os << std::endl;
+        }
     };
 
     template <class RealType, std::size_t StateBits>
@@ -43,41 +102,21 @@ namespace SokobanQLearning {
     public:
         RealType Get(const StateType &state,
                      const Sokoban::DirectionInt &action) const override {
-            if (!_map.count(state)) return 0;
-            switch (action) {
-                case Sokoban::Up:
-                    return _map.at(state).at(0);
-                case Sokoban::Left:
-                    return _map.at(state).at(1);
-                case Sokoban::Right:
-                    return _map.at(state).at(2);
-                case Sokoban::Down:
-                    return _map.at(state).at(3);
-                default:
-                    return 0;
-            }
+            const auto index = Sokoban::DirectionIndex(action);
+            if (index < 0) return 0;
+            const auto &row = _map.find(state);
+            return row == _map.end() ? 0 : row->second[index];
         }
 
         RowType Get(const StateType &state) const override {
-            return _map.count(state) ? _map.at(state) : RowType{{0, 0, 0, 0}};
+            const auto &row = _map.find(state);
+            return row == _map.end() ? RowType{{0, 0, 0, 0}} : row->second;
         }
 
         void Set(const StateType &state, const Sokoban::DirectionInt &action,
                  const RealType &value) override {
-            switch (action) {
-                case Sokoban::Up:
-                    _map[state][0] = value;
-                    return;
-                case Sokoban::Left:
-                    _map[state][1] = value;
-                    return;
-                case Sokoban::Right:
-                    _map[state][2] = value;
-                    return;
-                case Sokoban::Down:
-                    _map[state][3] = value;
-                    return;
-            }
+            const auto index = Sokoban::DirectionIndex(action);
+            if (index >= 0) _map[state][index] = value;
         }
 
         void Set(const StateType &state, const RowType &row) override {
@@ -87,45 +126,399 @@ namespace SokobanQLearning {
         bool Check(const StateType &state) const override {
             return _map.count(state);
         }
+
+        void ForEach(
+            const std::function<void(const StateType &, const RowType &)>
+                &function) const override {
+            for (const auto &p : _map) function(p.first, p.second);
+        }
     };
 
+    // A table that can be shared by threads: rows are spread over shards,
+    // each behind its own mutex. Blend reads and writes a value under one
+    // lock, so concurrent backups of the same pair are not lost; a backup
+    // may still bootstrap from a next state another thread is updating.
     template <class RealType, std::size_t StateBits>
-    class PrintableQTable : public QTable<RealType, StateBits> {
+    class ConcurrentQTable : public IQTable<RealType, StateBits> {
     public:
-        using typename QTable<RealType, StateBits>::StateType;
-        using typename QTable<RealType, StateBits>::RowType;
-        static constexpr std::size_t FirstColumnWidth =
-            std::max(2 + (StateBits >> 2) + !!(StateBits & 0b11),
-                     static_cast<std::size_t>(6));
+        using typename IQTable<RealType, StateBits>::StateType;
+        using typename IQTable<RealType, StateBits>::RowType;
 
-        void PrintStateRow(std::ostream &os, int precision, int column_width,
-                           const StateType &state) const {
-            os << std::right << std::setfill(' ') << std::setw(FirstColumnWidth)
-               << "0x" + Utils::BitsToHex(state) << std::setprecision(precision)
-               << std::fixed;
-            for (const auto &value : this->Get(state))
-                os << std::setw(column_width) << value;
-            os << std::endl;
+    protected:
+        struct Shard {
+            mutable std::mutex Mutex;
+            std::unordered_map<StateType, RowType> Map;
+        };
+
+        std::size_t _shard_count;
+        std::unique_ptr<Shard[]> _shards;
+
+        Shard &GetShard(const StateType &state) const {
+            return _shards[std::hash<StateType>()(state) % _shard_count];
         }
 
-        void PrintHeader(std::ostream &os, int column_width) const {
-            os << std::right << std::setfill(' ') << std::setw(FirstColumnWidth)
-               << "State";
-            for (const auto &d : Sokoban::AllDirections)
-                os << std::setw(column_width) << Sokoban::DirectionName(d);
-            os << std::endl;
+    public:
+        RealType Get(const StateType &state,
+                     const Sokoban::DirectionInt &action) const override {
+            const auto index = Sokoban::DirectionIndex(action);
+            if (index < 0) return 0;
+            auto &shard = GetShard(state);
+            std::lock_guard<std::mutex> lock(shard.Mutex);
+            const auto &row = shard.Map.find(state);
+            return row == shard.Map.end() ? 0 : row->second[index];
         }
 
-        void Print(std::ostream &os, int precision, int column_width) const {
-            os << std::string(FirstColumnWidth + 4 * column_width, '=')
-               << std::endl;
-            PrintHeader(os, column_width);
-            for (const auto &p : this->_map)
-                PrintStateRow(os, precision, column_width, p.first);
-            os << std::endl;
+        RowType Get(const StateType &state) const override {
+            auto &shard = GetShard(state);
+            std::lock_guard<std::mutex> lock(shard.Mutex);
+            const auto &row = shard.Map.find(state);
+            return row == shard.Map.end() ? RowType{{0, 0, 0, 0}}
+                                          : row->second;
+        }
+
+        void Set(const StateType &state, const Sokoban::DirectionInt &action,
+                 const RealType &value) override {
+            const auto index = Sokoban::DirectionIndex(action);
+            if (index < 0) return;
+            auto &shard = GetShard(state);
+            std::lock_guard<std::mutex> lock(shard.Mutex);
+            shard.Map[state][index] = value;
+        }
+
+        void Set(const StateType &state, const RowType &row) override {
+            auto &shard = GetShard(state);
+            std::lock_guard<std::mutex> lock(shard.Mutex);
+            shard.Map[state] = row;
+        }
+
+        void Blend(const StateType &state, const Sokoban::DirectionInt &action,
+                   const RealType &target, const RealType &alpha) override {
+            const auto index = Sokoban::DirectionIndex(action);
+            if (index < 0) return;
+            auto &shard = GetShard(state);
+            std::lock_guard<std::mutex> lock(shard.Mutex);
+            auto &value = shard.Map[state][index];
+            value = (static_cast<RealType>(1) - alpha) * value + alpha * target;
+        }
+
+        bool Check(const StateType &state) const override {
+            auto &shard = GetShard(state);
+            std::lock_guard<std::mutex> lock(shard.Mutex);
+            return shard.Map.count(state);
+        }
+
+        void ForEach(
+            const std::function<void(const StateType &, const RowType &)>
+                &function) const override {
+            for (std::size_t i = 0; i < _shard_count; ++i) {
+                std::lock_guard<std::mutex> lock(_shards[i].Mutex);
+                for (const auto &p : _shards[i].Map)
+                    function(p.first, p.second);
+            }
+        }
+
+        explicit ConcurrentQTable(std::size_t shard_count = 256)
+            : _shard_count(shard_count ? shard_count : 1),
+              _shards(new Shard[_shard_count]) {}
+    };
+
+    // Keeps two independent estimates in the two halves of one row, so both
+    // are fetched by a single lookup. A row takes 8 values instead of the 4 a
+    // QTable row takes. Reads through IQTable see the mean of the two, and
+    // writes through IQTable set both.
+    template <class RealType, std::size_t StateBits>
+    class DoubleQTable : public IQTable<RealType, StateBits> {
+    public:
+        using typename IQTable<RealType, StateBits>::StateType;
+        using typename IQTable<RealType, StateBits>::RowType;
+        typedef std::array<RealType, 8> LanesType;
+
+    protected:
+        std::unordered_map<StateType, LanesType> _map;
+
+        static RowType Mean(const LanesType &lanes) {
+            RowType row;
+            for (std::size_t i = 0; i < 4; ++i)
+                row[i] = (lanes[i] + lanes[i + 4]) / 2;
+            return row;
+        }
+
+    public:
+        RealType Get(const std::size_t &lane, const StateType &state,
+                     const Sokoban::DirectionInt &action) const {
+            const auto index = Sokoban::DirectionIndex(action);
+            if (index < 0) return 0;
+            const auto &lanes = _map.find(state);
+            return lanes == _map.end() ? 0 : lanes->second[lane * 4 + index];
+        }
+
+        void Set(const std::size_t &lane, const StateType &state,
+                 const Sokoban::DirectionInt &action, const RealType &value) {
+            const auto index = Sokoban::DirectionIndex(action);
+            if (index >= 0) _map[state][lane * 4 + index] = value;
+        }
+
+        RealType Get(const StateType &state,
+                     const Sokoban::DirectionInt &action) const override {
+            const auto index = Sokoban::DirectionIndex(action);
+            if (index < 0) return 0;
+            const auto &lanes = _map.find(state);
+            return lanes == _map.end()
+                       ? 0
+                       : (lanes->second[index] + lanes->second[index + 4]) / 2;
+        }
+
+        RowType Get(const StateType &state) const override {
+            const auto &lanes = _map.find(state);
+            return lanes == _map.end() ? RowType{{0, 0, 0, 0}}
+                                       : Mean(lanes->second);
+        }
+
+        void Set(const StateType &state, const Sokoban::DirectionInt &action,
+                 const RealType &value) override {
+            const auto index = Sokoban::DirectionIndex(action);
+            if (index < 0) return;
+            auto &lanes = _map[state];
+            lanes[index] = lanes[index + 4] = value;
+        }
+
+        void Set(const StateType &state, const RowType &row) override {
+            auto &lanes = _map[state];
+            std::copy(row.begin(), row.end(), lanes.begin());
+            std::copy(row.begin(), row.end(), lanes.begin() + 4);
+        }
+
+        bool Check(const StateType &state) const override {
+            return _map.count(state);
+        }
+
+        void ForEach(
+            const std::function<void(const StateType &, const RowType &)>
+                &function) const override {
+            for (const auto &p : _map) function(p.first, Mean(p.second));
+        }
+    };
+
+    // A QTable that also counts how many times each action has been taken
+    // from each state, in a lane of 32-bit counters next to the values, so
+    // one lookup fetches both.
+    template <class RealType, std::size_t StateBits>
+    class CountingQTable : public IQTable<RealType, StateBits> {
+    public:
+        using typename IQTable<RealType, StateBits>::StateType;
+        using typename IQTable<RealType, StateBits>::RowType;
+        typedef std::array<std::uint_least32_t, 4> CountsType;
+
+        struct Row {
+            RowType Values;
+            CountsType Counts;
+        };
+
+    protected:
+        std::unordered_map<StateType, Row> _map;
+
+    public:
+        const Row *Find(const StateType &state) const {
+            const auto &row = _map.find(state);
+            return row == _map.end() ? nullptr : &row->second;
+        }
+
+        CountsType Counts(const StateType &state) const {
+            const auto &row = _map.find(state);
+            return row == _map.end() ? CountsType{{0, 0, 0, 0}}
+                                     : row->second.Counts;
+        }
+
+        void Visit(const StateType &state,
+                   const Sokoban::DirectionInt &action) {
+            const auto index = Sokoban::DirectionIndex(action);
+            if (index >= 0) ++_map[state].Counts[index];
+        }
+
+        RealType Get(const StateType &state,
+                     const Sokoban::DirectionInt &action) const override {
+            const auto index = Sokoban::DirectionIndex(action);
+            if (index < 0) return 0;
+            const auto &row = _map.find(state);
+            return row == _map.end() ? 0 : row->second.Values[index];
+        }
+
+        RowType Get(const StateType &state) const override {
+            const auto &row = _map.find(state);
+            return row == _map.end() ? RowType{{0, 0, 0, 0}}
+                                     : row->second.Values;
+        }
+
+        void Set(const StateType &state, const Sokoban::DirectionInt &action,
+                 const RealType &value) override {
+            const auto index = Sokoban::DirectionIndex(action);
+            if (index >= 0) _map[state].Values[index] = value;
+        }
+
+        void Set(const StateType &state, const RowType &row) override {
+            _map[state].Values = row;
+        }
+
+        bool Check(const StateType &state) const override {
+            return _map.count(state);
+        }
+
+        void ForEach(
+            const std::function<void(const StateType &, const RowType &)>
+                &function) const override {
+            for (const auto &p : _map) function(p.first, p.second.Values);
         }
     };
 
+    // A QTable kept in one flat array with open addressing and linear
+    // probing, so copying a whole table is a single vector copy rather than
+    // one allocation per state. The capacity is a power of two and doubles
+    // once half of it is used.
+    template <class RealType, std::size_t StateBits>
+    class FlatQTable : public IQTable<RealType, StateBits> {
+    public:
+        using typename IQTable<RealType, StateBits>::StateType;
+        using typename IQTable<RealType, StateBits>::RowType;
+
+    protected:
+        struct Slot {
+            StateType State;
+            RowType Row;
+            bool Used;
+        };
+
+        std::vector<Slot> _slots;
+        std::size_t _size;
+        unsigned _shift;
+
+        // The slot holding `state`, or the empty slot it would go into.
+        std::size_t Probe(const StateType &state) const {
+            const std::size_t mask = _slots.size() - 1;
+            std::size_t i = static_cast<std::uint_least64_t>(
+                                std::hash<StateType>()(state)) *
+                            UINT64_C(0x9E3779B97F4A7C15) >>
+                            _shift;
+            while (_slots[i].Used && _slots[i].State != state)
+                i = (i + 1) & mask;
+            return i;
+        }
+
+        void Grow() {
+            std::vector<Slot> slots(_slots.size() * 2);
+            _slots.swap(slots);
+            --_shift;
+            for (const auto &slot : slots)
+                if (slot.Used) _slots[Probe(slot.State)] = slot;
+        }
+
+        RowType &Insert(const StateType &state) {
+            auto i = Probe(state);
+            if (_slots[i].Used) return _slots[i].Row;
+            if ((_size + 1) * 2 > _slots.size()) {
+                Grow();
+                i = Probe(state);
+            }
+            ++_size;
+            _slots[i] = {state, {{0, 0, 0, 0}}, true};
+            return _slots[i].Row;
+        }
+
+    public:
+        const RowType *Find(const StateType &state) const {
+            const auto &slot = _slots[Probe(state)];
+            return slot.Used ? &slot.Row : nullptr;
+        }
+
+        const std::size_t &Size() const { return _size; }
+
+        void Clear() { *this = FlatQTable(); }
+
+        RealType Get(const StateType &state,
+                     const Sokoban::DirectionInt &action) const override {
+            const auto index = Sokoban::DirectionIndex(action);
+            if (index < 0) return 0;
+            const auto &row = Find(state);
+            return row ? (*row)[index] : 0;
+        }
+
+        RowType Get(const StateType &state) const override {
+            const auto &row = Find(state);
+            return row ? *row : RowType{{0, 0, 0, 0}};
+        }
+
+        void Set(const StateType &state, const Sokoban::DirectionInt &action,
+                 const RealType &value) override {
+            const auto index = Sokoban::DirectionIndex(action);
+            if (index >= 0) Insert(state)[index] = value;
+        }
+
+        void Set(const StateType &state, const RowType &row) override {
+            Insert(state) = row;
+        }
+
+        bool Check(const StateType &state) const override {
+            return Find(state);
+        }
+
+        void ForEach(
+            const std::function<void(const StateType &, const RowType &)>
+                &function) const override {
+            for (const auto &slot : _slots)
+                if (slot.Used) function(slot.State, slot.Row);
+        }
+
+        FlatQTable() : _slots(16), _size(0), _shift(60) {}
+    };
+
+    template <class RealType>
+    struct RewardConfig {
+        RealType RetracePenalty = 1, PushReward = 0.5, GoalReward = 50,
+                 FailurePenalty = 1000, SuccessReward = 1000;
+        // Weight of the potential-based shaping term
+        // gamma * PushPotential(s') - PushPotential(s), with the potential of
+        // a finished state taken as 0. Being a difference of potentials, it
+        // does not change which policies are optimal.
+        RealType Shaping = 0;
+    };
+
+    template <class RealType>
+    struct TrainParams {
+        double Epsilon;
+        RealType Alpha, Gamma;
+        RewardConfig<RealType> Rewards;
+
+        // Bootstrap value of a state with no legal action, below any value
+        // the table can learn for a state with one.
+        RealType MinQ(const std::size_t &box_count) const {
+            return -(Rewards.RetracePenalty + Rewards.FailurePenalty +
+                     Rewards.GoalReward * box_count);
+        }
+    };
+
+    // Minus the total number of pushes the boxes need to reach goals, each
+    // counted as if it were the only box; a box that can reach no goal
+    // counts one push per floor cell.
+    template <class RealType, std::size_t StateBits>
+    RealType PushPotential(const Sokoban::Game<StateBits> &game) {
+        const auto &distance = game.GetBoxDistance();
+        RealType potential = 0;
+        for (const auto &b : game.GetBoxPos()) {
+            const auto &d = distance[game.GetFloorIndex()[b.first][b.second]];
+            potential -= d >= 0 ? d : distance.size();
+        }
+        return potential;
+    }
+
+    template <class RealType, std::size_t StateBits>
+    struct Transition {
+        typedef typename IQTable<RealType, StateBits>::StateType StateType;
+
+        StateType LastState, State;
+        Sokoban::DirectionInt Action, Directions;
+        RealType Reward;
+        bool Pushed, Done;
+    };
+
     template <class RealType, std::size_t StateBits>
     struct TrainResult {
     public:
@@ -175,49 +568,277 @@ namespace SokobanQLearning {
         TrainResult(const StateType &last_state, const RowType &old_row)
             : TrainResult(last_state, old_row, Sokoban::NoDirection, 0, false,
                           old_row) {}
+        TrainResult(const Transition<RealType, StateBits> &transition,
+                    const RowType &old_row, const RowType &new_row)
+            : TrainResult(transition.LastState, old_row, transition.Action,
+                          transition.Reward, transition.Pushed, new_row) {}
+    };
+
+    // The greatest value among the lanes of `row` whose bit is set in
+    // `actions`, the lanes holding it, and whether every such lane holds it.
+    // `actions` must not be empty.
+    template <class RealType>
+    struct MaskedMax {
+        RealType Max;
+        Sokoban::DirectionInt Lanes;
+        bool AllSame;
     };
 
+    template <class RealType>
+    MaskedMax<RealType> FindMaskedMax(const std::array<RealType, 4> &row,
+                                      const Sokoban::DirectionInt &actions) {
+        RealType max = std::numeric_limits<RealType>::lowest();
+        RealType min = std::numeric_limits<RealType>::max();
+        for (int i = 0; i < 4; ++i) {
+            const bool legal = actions >> i & 1;
+            max = std::max(max, legal ? row[i] : max);
+            min = std::min(min, legal ? row[i] : min);
+        }
+        Sokoban::DirectionInt lanes = Sokoban::NoDirection;
+        for (int i = 0; i < 4; ++i) lanes |= (row[i] == max) << i;
+        return {max, static_cast<Sokoban::DirectionInt>(lanes & actions),
+                min == max};
+    }
+
+#ifdef SokobanQLearning_USE_SSE_
+    inline MaskedMax<float> FindMaskedMax(
+        const std::array<float, 4> &row, const Sokoban::DirectionInt &actions) {
+        const __m128i bits = _mm_set_epi32(8, 4, 2, 1);
+        const __m128 legal = _mm_castsi128_ps(_mm_cmpeq_epi32(
+            _mm_and_si128(_mm_set1_epi32(actions), bits), bits));
+        const __m128 values = _mm_loadu_ps(row.data());
+        __m128 max = _mm_or_ps(
+            _mm_and_ps(legal, values),
+            _mm_andnot_ps(legal,
+                          _mm_set1_ps(std::numeric_limits<float>::lowest())));
+        __m128 min = _mm_or_ps(
+            _mm_and_ps(legal, values),
+            _mm_andnot_ps(legal,
+                          _mm_set1_ps(std::numeric_limits<float>::max())));
+        max = _mm_max_ps(max, _mm_shuffle_ps(max, max, 0b10110001));
+        max = _mm_max_ps(max, _mm_shuffle_ps(max, max, 0b01001110));
+        min = _mm_min_ps(min, _mm_shuffle_ps(min, min, 0b10110001));
+        min = _mm_min_ps(min, _mm_shuffle_ps(min, min, 0b01001110));
+        const int lanes = _mm_movemask_ps(
+            _mm_and_ps(legal, _mm_cmpeq_ps(values, max)));
+        return {_mm_cvtss_f32(max), static_cast<Sokoban::DirectionInt>(lanes),
+                _mm_cvtss_f32(min) == _mm_cvtss_f32(max)};
+    }
+#endif
+
+    // Epsilon-greedy over the legal actions given their row of Q. A random
+    // action is also taken when all legal actions have the same value;
+    // otherwise the first one holding the maximum is.
+    template <class URNG, class RealType>
+    Sokoban::DirectionInt ChooseAction(URNG &random_generator,
+                                       const double &epsilon,
+                                       const Sokoban::DirectionInt &actions,
+                                       const std::array<RealType, 4> &row) {
+        const auto &max = FindMaskedMax(row, actions);
+        const auto &random = Utils::UniformReal(random_generator);
+        if (max.AllSame || random < epsilon) {
+            auto random_choice = Utils::UniformInt(
+                random_generator, std::bitset<4>(actions).count());
+            Sokoban::DirectionInt actions_remain = actions;
+            while (random_choice--) actions_remain &= actions_remain - 1;
+            return actions_remain & -actions_remain;
+        }
+        return max.Lanes & -max.Lanes;
+    }
+
+    // ChooseAction on the state of `game`, looking the row up only when
+    // there is more than one legal action.
     template <class URNG, class RealType, std::size_t StateBits>
     Sokoban::DirectionInt FindAction(URNG &random_generator,
                                      const double &epsilon,
                                      const Sokoban::Game<StateBits> &game,
                                      const IQTable<RealType, StateBits> &Q) {
         const auto &actions = game.GetDirections();
-        if (!actions) return Sokoban::NoDirection;
-        const auto &state = game.GetState();
-        bool all_same = true;
-        Sokoban::BitsInt action_count = 1;
-        Sokoban::DirectionInt actions_remain = actions & (actions - 1);
-        Sokoban::DirectionInt last_action = actions & -actions;
-        Sokoban::DirectionInt current_action = actions_remain & -actions_remain;
-        RealType last_Q = Q.Get(state, last_action);
-        RealType current_Q = Q.Get(state, current_action);
-        RealType max_Q = last_Q;
-        Sokoban::DirectionInt choice = actions & -actions;
-        while (actions_remain) {
-            ++action_count;
-            all_same = all_same && last_Q == current_Q;
-            if (current_Q > max_Q) {
-                max_Q = current_Q;
-                choice = current_action;
+        if (!(actions & (actions - 1))) return actions;
+        return ChooseAction(random_generator, epsilon, actions,
+                            Q.Get(game.GetState()));
+    }
+
+    template <class RealType, std::size_t StateBits>
+    RealType MaxQ(const IQTable<RealType, StateBits> &Q,
+                  const typename IQTable<RealType, StateBits>::StateType &state,
+                  const Sokoban::DirectionInt &actions,
+                  const RealType &min_Q) {
+        return actions
+                   ? std::max(min_Q, FindMaskedMax(Q.Get(state), actions).Max)
+                   : min_Q;
+    }
+
+    template <class RealType, std::size_t StateBits>
+    Transition<RealType, StateBits> Act(Sokoban::Game<StateBits> &game,
+                                        const Sokoban::DirectionInt &action,
+                                        const TrainParams<RealType> &params) {
+        Transition<RealType, StateBits> transition;
+        transition.LastState = game.GetState();
+        transition.Action = action;
+        const auto &rewards = params.Rewards;
+        const auto last_finished = game.GetFinished();
+        const RealType last_potential =
+            rewards.Shaping ? PushPotential<RealType>(game) : 0;
+        transition.Pushed = game.Move(action);
+        transition.State = game.GetState();
+        transition.Directions = game.GetDirections();
+        transition.Done = game.GetSucceeded() || game.GetFailed();
+        RealType reward =
+            rewards.GoalReward * (game.GetFinished() - last_finished);
+        if (game.GetStateHistory().count(transition.State))
+            reward -= rewards.RetracePenalty;
+        if (transition.Pushed) reward += rewards.PushReward;
+        if (game.GetSucceeded()) reward += rewards.SuccessReward;
+        if (game.GetFailed()) reward -= rewards.FailurePenalty;
+        if (rewards.Shaping)
+            reward += rewards.Shaping *
+                      ((transition.Done
+                            ? 0
+                            : params.Gamma * PushPotential<RealType>(game)) -
+                       last_potential);
+        transition.Reward = reward;
+        return transition;
+    }
+
+    template <class RealType, std::size_t StateBits>
+    void Backup(IQTable<RealType, StateBits> &Q,
+                const Transition<RealType, StateBits> &transition,
+                const RealType &alpha, const RealType &gamma,
+                const RealType &min_Q) {
+        const auto max_Q =
+            MaxQ(Q, transition.State, transition.Directions, min_Q);
+        Q.Blend(transition.LastState, transition.Action,
+                transition.Reward + gamma * max_Q, alpha);
+    }
+
+    template <class URNG, class RealType, std::size_t StateBits>
+    TrainResult<RealType, StateBits> Train(
+        URNG &random_generator, Sokoban::Game<StateBits> &game,
+        IQTable<RealType, StateBits> &Q, const TrainParams<RealType> &params) {
+        const auto last_state = game.GetState();
+        const auto old_row = Q.Get(last_state);
+        if (game.GetSucceeded() || game.GetFailed()) {
+            game.Restart();
+            return {last_state, old_row};
+        }
+        const auto &transition = Act(
+            game, FindAction(random_generator, params.Epsilon, game, Q),
+            params);
+        Backup(Q, transition, params.Alpha, params.Gamma,
+               params.MinQ(game.GetBoxPos0().size()));
+        return {transition, old_row, Q.Get(last_state)};
+    }
+
+    enum class StepStatus : std::uint_least8_t {
+        Restarted,
+        Moved,
+        Succeeded,
+        Failed
+    };
+
+    // Same step as Train, for headless loops: no row is copied for
+    // TrainResult, and only the outcome is returned.
+    template <class URNG, class RealType, std::size_t StateBits>
+    StepStatus TrainLean(URNG &random_generator, Sokoban::Game<StateBits> &game,
+                         IQTable<RealType, StateBits> &Q,
+                         const TrainParams<RealType> &params) {
+        if (game.GetSucceeded() || game.GetFailed()) {
+            game.Restart();
+            return StepStatus::Restarted;
+        }
+        Backup(Q,
+               Act(game, FindAction(random_generator, params.Epsilon, game, Q),
+                   params),
+               params.Alpha, params.Gamma,
+               params.MinQ(game.GetBoxPos0().size()));
+        return game.GetSucceeded()
+                   ? StepStatus::Succeeded
+                   : game.GetFailed() ? StepStatus::Failed : StepStatus::Moved;
+    }
+
+    struct EpisodeStats {
+        Sokoban::TimeInt Steps = 0, Episodes = 0, Successes = 0, Failures = 0;
+        // Steps of the episodes counted in Episodes.
+        Sokoban::TimeInt EpisodeSteps = 0;
+        double Seconds = 0;
+
+        double MeanLength() const {
+            return Episodes ? static_cast<double>(EpisodeSteps) / Episodes : 0;
+        }
+
+        double StepsPerSecond() const {
+            return Seconds > 0 ? Steps / Seconds : 0;
+        }
+
+        EpisodeStats &operator+=(const EpisodeStats &other) {
+            Steps += other.Steps;
+            Episodes += other.Episodes;
+            Successes += other.Successes;
+            Failures += other.Failures;
+            EpisodeSteps += other.EpisodeSteps;
+            Seconds += other.Seconds;
+            return *this;
+        }
+
+        void Print(std::ostream &os, int precision) const {
+            os << std::fixed << std::setprecision(precision)
+               << "Steps: " << Steps << " (" << StepsPerSecond() << "/s)"
+               << std::endl
+               << "Episodes: " << Episodes << std::endl
+               << "Successes: " << Successes << std::endl
+               << "Failures: " << Failures << std::endl
+               << "Mean Length: " << MeanLength() << std::endl;
+        }
+    };
+
+    // Runs TrainLean steps until `max_steps` steps or `max_episodes` finished
+    // episodes, whichever comes first (0 means no limit on that one, but at
+    // least one must be set), and restarts finished episodes straight away
+    // rather than on the next call.
+    template <class URNG, class RealType, std::size_t StateBits>
+    EpisodeStats TrainEpisodes(URNG &random_generator,
+                               Sokoban::Game<StateBits> &game,
+                               IQTable<RealType, StateBits> &Q,
+                               const TrainParams<RealType> &params,
+                               const Sokoban::TimeInt &max_episodes,
+                               const Sokoban::TimeInt &max_steps) {
+        if (!max_episodes && !max_steps)
+            throw std::invalid_argument("TrainEpisodes needs a limit");
+        const auto start = std::chrono::steady_clock::now();
+        const double epsilon = params.Epsilon;
+        const RealType alpha = params.Alpha, gamma = params.Gamma;
+        const RealType min_Q = params.MinQ(game.GetBoxPos0().size());
+        Sokoban::TimeInt steps = 0, episodes = 0, successes = 0, failures = 0,
+                         episode_steps = 0;
+        if (game.GetSucceeded() || game.GetFailed()) game.Restart();
+        while ((!max_steps || steps < max_steps) &&
+               (!max_episodes || episodes < max_episodes)) {
+            Backup(Q,
+                   Act(game, FindAction(random_generator, epsilon, game, Q),
+                       params),
+                   alpha, gamma, min_Q);
+            ++steps;
+            const bool succeeded = game.GetSucceeded();
+            const bool failed = game.GetFailed();
+            if (succeeded || failed) {
+                ++episodes;
+                successes += succeeded;
+                failures += failed;
+                episode_steps += game.GetTimeElapsed();
+                game.Restart();
             }
-            actions_remain &= actions_remain - 1;
-            last_action = current_action;
-            last_Q = current_Q;
-            current_action = actions_remain & -actions_remain;
-            current_Q = Q.Get(state, current_action);
-        }
-        if (action_count == 1) return actions;
-        const auto &random =
-            std::uniform_real_distribution<double>(0.0, 1.0)(random_generator);
-        if (all_same || random < epsilon) {
-            Sokoban::BitsInt random_choice = std::uniform_int_distribution<int>(
-                0, action_count - 1)(random_generator);
-            actions_remain = actions;
-            while (random_choice--) actions_remain &= actions_remain - 1;
-            return actions_remain & -actions_remain;
-        } else
-            return choice;
+        }
+        EpisodeStats stats;
+        stats.Steps = steps;
+        stats.Episodes = episodes;
+        stats.Successes = successes;
+        stats.Failures = failures;
+        stats.EpisodeSteps = episode_steps;
+        stats.Seconds = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+        return stats;
     }
 
     template <class URNG, class RealType, std::size_t StateBits>
@@ -228,32 +849,114 @@ namespace SokobanQLearning {
         const RealType &retrace_penalty, const RealType &push_reward,
         const RealType &goal_reward, const RealType &failure_penalty,
         const RealType &success_reward) {
+        return Train(random_generator, game, Q,
+                     TrainParams<RealType>{
+                         epsilon, alpha, gamma,
+                         RewardConfig<RealType>{retrace_penalty, push_reward,
+                                                goal_reward, failure_penalty,
+                                                success_reward, 0}});
+    }
+
+    // Double Q-learning: a random one of the two estimates picks the greedy
+    // next action and the other one values it, which removes the upward bias
+    // of taking the max over a single noisy estimate.
+    template <class URNG, class RealType, std::size_t StateBits>
+    TrainResult<RealType, StateBits> TrainDouble(
+        URNG &random_generator, Sokoban::Game<StateBits> &game,
+        DoubleQTable<RealType, StateBits> &Q,
+        const TrainParams<RealType> &params) {
         const auto last_state = game.GetState();
         const auto old_row = Q.Get(last_state);
         if (game.GetSucceeded() || game.GetFailed()) {
             game.Restart();
             return {last_state, old_row};
         }
-        const auto last_finished = game.GetFinished();
-        const auto last_action = FindAction(random_generator, epsilon, game, Q);
-        const bool pushed = game.Move(last_action);
-        const auto state = game.GetState();
-        RealType reward = goal_reward * (game.GetFinished() - last_finished);
-        if (game.GetStateHistory().count(state)) reward -= retrace_penalty;
-        if (pushed) reward += push_reward;
-        if (game.GetSucceeded()) reward += success_reward;
-        if (game.GetFailed()) reward -= failure_penalty;
-        const auto actions = game.GetDirections();
-        RealType max_Q = -(retrace_penalty + failure_penalty +
-                           goal_reward * game.GetBoxPos0().size());
-        for (const auto &d : Sokoban::AllDirections)
-            if (actions & d) max_Q = std::max(max_Q, Q.Get(state, d));
-        Q.Set(last_state, last_action,
-              (static_cast<RealType>(1) - alpha) *
-                      Q.Get(last_state, last_action) +
-                  alpha * (reward + gamma * max_Q));
-        return {last_state, old_row, last_action,
-                reward,     pushed,  Q.Get(last_state)};
+        const auto &transition = Act(
+            game, FindAction(random_generator, params.Epsilon, game, Q),
+            params);
+        const std::size_t lane = Utils::UniformInt(random_generator, 2);
+        const auto min_Q = params.MinQ(game.GetBoxPos0().size());
+        RealType next_Q = min_Q;
+        Sokoban::DirectionInt next_action = Sokoban::NoDirection;
+        RealType max_Q = 0;
+        for (const auto &d : Sokoban::AllDirections) {
+            if (!(transition.Directions & d)) continue;
+            const auto value = Q.Get(lane, transition.State, d);
+            if (!next_action || value > max_Q) {
+                next_action = d;
+                max_Q = value;
+            }
+        }
+        if (next_action)
+            next_Q = std::max(
+                min_Q, Q.Get(1 - lane, transition.State, next_action));
+        Q.Set(lane, last_state, transition.Action,
+              (static_cast<RealType>(1) - params.Alpha) *
+                      Q.Get(lane, last_state, transition.Action) +
+                  params.Alpha * (transition.Reward + params.Gamma * next_Q));
+        return {transition, old_row, Q.Get(last_state)};
+    }
+
+    // UCB1: picks the legal action maximizing
+    // Q(s, a) + exploration * sqrt(ln N(s) / N(s, a)), where N(s) sums the
+    // counts of the legal actions. Untried actions come first, and ties are
+    // broken at random.
+    template <class URNG, class RealType, std::size_t StateBits>
+    Sokoban::DirectionInt FindActionUCB(
+        URNG &random_generator, const RealType &exploration,
+        const Sokoban::Game<StateBits> &game,
+        const CountingQTable<RealType, StateBits> &Q) {
+        const auto &actions = game.GetDirections();
+        if (!actions) return Sokoban::NoDirection;
+        const auto *row = Q.Find(game.GetState());
+        double total = 0;
+        if (row)
+            for (const auto &d : Sokoban::AllDirections)
+                if (actions & d)
+                    total += row->Counts[Sokoban::DirectionIndex(d)];
+        const double log_total = total > 1 ? std::log(total) : 0;
+        Sokoban::DirectionInt choice = Sokoban::NoDirection;
+        double max_score = 0;
+        int ties = 0;
+        for (const auto &d : Sokoban::AllDirections) {
+            if (!(actions & d)) continue;
+            const auto index = Sokoban::DirectionIndex(d);
+            const auto count = row ? row->Counts[index] : 0;
+            const double score =
+                count ? row->Values[index] +
+                            exploration * std::sqrt(log_total / count)
+                      : std::numeric_limits<double>::infinity();
+            if (!choice || score > max_score) {
+                choice = d;
+                max_score = score;
+                ties = 1;
+            } else if (score == max_score &&
+                       !Utils::UniformInt(random_generator, ++ties))
+                choice = d;
+        }
+        return choice;
+    }
+
+    // Q-learning exploring with FindActionUCB instead of epsilon-greedy;
+    // params.Epsilon is not used.
+    template <class URNG, class RealType, std::size_t StateBits>
+    TrainResult<RealType, StateBits> TrainUCB(
+        URNG &random_generator, Sokoban::Game<StateBits> &game,
+        CountingQTable<RealType, StateBits> &Q, const RealType &exploration,
+        const TrainParams<RealType> &params) {
+        const auto last_state = game.GetState();
+        const auto old_row = Q.Get(last_state);
+        if (game.GetSucceeded() || game.GetFailed()) {
+            game.Restart();
+            return {last_state, old_row};
+        }
+        const auto action =
+            FindActionUCB(random_generator, exploration, game, Q);
+        Q.Visit(last_state, action);
+        const auto &transition = Act(game, action, params);
+        Backup(Q, transition, params.Alpha, params.Gamma,
+               params.MinQ(game.GetBoxPos0().size()));
+        return {transition, old_row, Q.Get(last_state)};
     }
 }  // namespace SokobanQLearning
 
@@ -0,0 +1,215 @@
+#ifndef SokobanQLearning_Sweep_HPP_
+#define SokobanQLearning_Sweep_HPP_ 1
+
+#include "./Evaluation.hpp"
+#include "./Parallel.hpp"
+#include "./Sokoban.hpp"
+#include "./SokobanQLearning.hpp"
+#include "./Utils.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace SokobanQLearning {
+    // Sets the parameter called `name`: epsilon, alpha, gamma, retrace,
+    // push, goal, failure, success or shaping. Returns false for any other
+    // name.
+    template <class RealType>
+    bool SetParam(TrainParams<RealType> &params, const std::string &name,
+                  const double &value) {
+        const auto real = static_cast<RealType>(value);
+        if (name == "epsilon")
+            params.Epsilon = value;
+        else if (name == "alpha")
+            params.Alpha = real;
+        else if (name == "gamma")
+            params.Gamma = real;
+        else if (name == "retrace")
+            params.Rewards.RetracePenalty = real;
+        else if (name == "push")
+            params.Rewards.PushReward = real;
+        else if (name == "goal")
+            params.Rewards.GoalReward = real;
+        else if (name == "failure")
+            params.Rewards.FailurePenalty = real;
+        else if (name == "success")
+            params.Rewards.SuccessReward = real;
+        else if (name == "shaping")
+            params.Rewards.Shaping = real;
+        else
+            return false;
+        return true;
+    }
+
+    // One swept parameter: a list of values, or a range [Low, High] that
+    // only random search can draw from.
+    struct SweepAxis {
+        std::string Name;
+        std::vector<double> Values;
+        double Low = 0, High = 0;
+
+        bool IsRange() const { return Values.empty(); }
+    };
+
+    // Parses "<name>=<value>,<value>,...", or "<name>=<low>:<high>" for a
+    // range, with axes separated by ';'.
+    inline std::vector<SweepAxis> ParseSweep(const std::string &spec) {
+        std::vector<SweepAxis> axes;
+        TrainParams<double> params{};
+        std::string::size_type first = 0;
+        while (first <= spec.size()) {
+            auto last = spec.find(';', first);
+            if (last == std::string::npos) last = spec.size();
+            const auto &field = spec.substr(first, last - first);
+            first = last + 1;
+            if (field.empty()) continue;
+            const auto equal = field.find('=');
+            if (equal == std::string::npos)
+                throw std::invalid_argument("Invalid Sweep: " + field);
+            SweepAxis axis;
+            axis.Name = field.substr(0, equal);
+            if (!SetParam(params, axis.Name, 0))
+                throw std::invalid_argument("Invalid Sweep: " + field);
+            const auto &values = field.substr(equal + 1);
+            const auto colon = values.find(':');
+            if (colon != std::string::npos) {
+                axis.Low = std::stod(values.substr(0, colon));
+                axis.High = std::stod(values.substr(colon + 1));
+            } else
+                for (std::string::size_type i = 0; i <= values.size();) {
+                    auto comma = values.find(',', i);
+                    if (comma == std::string::npos) comma = values.size();
+                    axis.Values.push_back(
+                        std::stod(values.substr(i, comma - i)));
+                    i = comma + 1;
+                }
+            axes.push_back(std::move(axis));
+        }
+        return axes;
+    }
+
+    // Every combination of the listed values, the first axis varying
+    // slowest. Ranges are not allowed.
+    template <class RealType>
+    std::vector<TrainParams<RealType>> SweepGrid(
+        const std::vector<SweepAxis> &axes, const TrainParams<RealType> &base) {
+        std::vector<TrainParams<RealType>> configs(1, base);
+        for (const auto &axis : axes) {
+            if (axis.IsRange())
+                throw std::invalid_argument("Range In Grid: " + axis.Name);
+            std::vector<TrainParams<RealType>> next;
+            next.reserve(configs.size() * axis.Values.size());
+            for (const auto &config : configs)
+                for (const auto &value : axis.Values) {
+                    next.push_back(config);
+                    SetParam(next.back(), axis.Name, value);
+                }
+            configs = std::move(next);
+        }
+        return configs;
+    }
+
+    // `count` configurations, each value drawn uniformly from its axis.
+    template <class RealType, class URNG>
+    std::vector<TrainParams<RealType>> SweepRandom(
+        URNG &random_generator, const std::vector<SweepAxis> &axes,
+        const TrainParams<RealType> &base, const std::size_t &count) {
+        std::vector<TrainParams<RealType>> configs(count, base);
+        for (auto &config : configs)
+            for (const auto &axis : axes)
+                SetParam(config, axis.Name,
+                         axis.IsRange()
+                             ? axis.Low + (axis.High - axis.Low) *
+                                              Utils::UniformReal(
+                                                  random_generator)
+                             : axis.Values[Utils::UniformInt(
+                                   random_generator, axis.Values.size())]);
+        return configs;
+    }
+
+    template <class RealType>
+    struct SweepResult {
+        TrainParams<RealType> Params;
+        // Steps trained, and steps until the first successful episode, 0 if
+        // there was none.
+        Sokoban::TimeInt Steps = 0, FirstSuccess = 0;
+        EvaluationResult Greedy;
+        bool Converged = false;
+        double Seconds = 0;
+
+        static void PrintCsvHeader(std::ostream &os) {
+            os << "epsilon,alpha,gamma,retrace,push,goal,failure,success,"
+                  "shaping,steps,first_success,solved,solution_steps,"
+                  "solution_pushes,converged,seconds"
+               << std::endl;
+        }
+
+        void PrintCsv(std::ostream &os) const {
+            const auto &r = Params.Rewards;
+            os << Params.Epsilon << ',' << Params.Alpha << ',' << Params.Gamma
+               << ',' << r.RetracePenalty << ',' << r.PushReward << ','
+               << r.GoalReward << ',' << r.FailurePenalty << ','
+               << r.SuccessReward << ',' << r.Shaping << ',' << Steps << ','
+               << FirstSuccess << ',' << Greedy.Solved << ',' << Greedy.Steps
+               << ',' << Greedy.Pushes << ',' << Converged << ',' << Seconds
+               << std::endl;
+        }
+    };
+
+    // Trains a fresh QTable for every configuration on `thread_count`
+    // threads, configuration i from seed stream i + 1 of `seed` (stream 0 is
+    // left to the caller), for at most `budget` steps. A greedy rollout of
+    // at most `max_steps` steps is evaluated every `interval` steps, or only
+    // at the end if it is 0, and training stops early once `stop_after` of
+    // them in a row solve the level with the same length (see
+    // ConvergenceMonitor). The last evaluation is reported.
+    template <class URNG, class RealType, std::size_t StateBits>
+    std::vector<SweepResult<RealType>> RunSweep(
+        const Sokoban::Game<StateBits> &game,
+        const std::vector<TrainParams<RealType>> &configs,
+        const Sokoban::TimeInt &budget, const Sokoban::TimeInt &interval,
+        const std::size_t &stop_after, const Sokoban::TimeInt &max_steps,
+        const std::size_t &thread_count, const std::uint_least64_t &seed,
+        const std::atomic_bool &stop) {
+        std::vector<SweepResult<RealType>> results(configs.size());
+        const auto every = interval ? interval : budget;
+        ParallelFor(
+            thread_count, configs.size(),
+            [&](const std::size_t &job, const std::size_t &) -> void {
+                const auto start = std::chrono::steady_clock::now();
+                auto &result = results[job];
+                result.Params = configs[job];
+                auto random_generator = Utils::SeedStream<URNG>(seed, job + 1);
+                QTable<RealType, StateBits> Q;
+                auto actor = game;
+                actor.Restart();
+                ConvergenceMonitor monitor(stop_after);
+                while (result.Steps < budget && !result.Converged &&
+                       !stop.load(std::memory_order_relaxed)) {
+                    const auto &status =
+                        TrainLean(random_generator, actor, Q, result.Params);
+                    ++result.Steps;
+                    if (status == StepStatus::Succeeded &&
+                        !result.FirstSuccess)
+                        result.FirstSuccess = result.Steps;
+                    if (result.Steps % every && result.Steps < budget)
+                        continue;
+                    result.Greedy =
+                        Evaluate(random_generator, game, Q, 0, max_steps);
+                    result.Converged = monitor.Add(result.Greedy);
+                }
+                result.Seconds = std::chrono::duration<double>(
+                                     std::chrono::steady_clock::now() - start)
+                                     .count();
+            });
+        return results;
+    }
+}  // namespace SokobanQLearning
+
+#endif  // SokobanQLearning_Sweep_HPP_
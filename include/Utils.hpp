@@ -1,11 +1,16 @@
 #ifndef SokobanQLearning_Utils_HPP_
 #define SokobanQLearning_Utils_HPP_ 1
 
+#include <array>
 #include <bitset>
 #include <cstddef>
+#include <cstdint>
 #include <iomanip>
+#include <limits>
+#include <random>
 #include <sstream>
 #include <string>
+#include <type_traits>
 
 namespace Utils {
     template <std::size_t N>
@@ -18,6 +23,165 @@ namespace Utils {
         return oss.str();
     }
 
+    // xoshiro256** by Blackman and Vigna: 32 bytes of state, a period of
+    // 2^256 - 1, and Jump for 2^128 non-overlapping subsequences.
+    class Xoshiro256 {
+    public:
+        typedef std::uint_least64_t result_type;
+
+    protected:
+        std::array<result_type, 4> _state;
+
+        static result_type Rotate(const result_type &x, int k) {
+            return (x << k) | (x >> (64 - k));
+        }
+
+        // SplitMix64, to fill the state from a single 64-bit seed.
+        static result_type Mix(result_type &x) {
+            result_type z = (x += 0x9e3779b97f4a7c15);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+            return z ^ (z >> 31);
+        }
+
+    public:
+        static constexpr result_type min() { return 0; }
+
+        static constexpr result_type max() {
+            return std::numeric_limits<result_type>::max();
+        }
+
+        result_type operator()() {
+            const result_type result = Rotate(_state[1] * 5, 7) * 9;
+            const result_type t = _state[1] << 17;
+            _state[2] ^= _state[0];
+            _state[3] ^= _state[1];
+            _state[1] ^= _state[2];
+            _state[0] ^= _state[3];
+            _state[2] ^= t;
+            _state[3] = Rotate(_state[3], 45);
+            return result;
+        }
+
+        // Advances by 2^128 steps.
+        void Jump() {
+            constexpr result_type jump[] = {
+                0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa,
+                0x39abdc4529b1661c};
+            std::array<result_type, 4> state{{0, 0, 0, 0}};
+            for (const auto &j : jump)
+                for (int b = 0; b < 64; ++b) {
+                    if (j >> b & 1)
+                        for (int i = 0; i < 4; ++i) state[i] ^= _state[i];
+                    (*this)();
+                }
+            _state = state;
+        }
+
+        void seed(result_type value) {
+            for (auto &s : _state) s = Mix(value);
+        }
+
+        explicit Xoshiro256(const result_type &value = 0) { seed(value); }
+
+        template <class SeedSeq,
+                  class = std::enable_if_t<!std::is_arithmetic<SeedSeq>::value>>
+        explicit Xoshiro256(SeedSeq &seeds) {
+            std::array<std::uint_least32_t, 8> words;
+            seeds.generate(words.begin(), words.end());
+            for (int i = 0; i < 4; ++i)
+                _state[i] = static_cast<result_type>(words[2 * i]) << 32 |
+                            words[2 * i + 1];
+            if (!(_state[0] | _state[1] | _state[2] | _state[3])) seed(0);
+        }
+    };
+
+    template <class URNG>
+    URNG SeedStream(const std::uint_least64_t &seed,
+                    const std::uint_least64_t &index, std::false_type) {
+        std::seed_seq seeds{static_cast<std::uint_least32_t>(seed),
+                            static_cast<std::uint_least32_t>(seed >> 32),
+                            static_cast<std::uint_least32_t>(index)};
+        return URNG(seeds);
+    }
+
+    template <class URNG>
+    URNG SeedStream(const std::uint_least64_t &seed,
+                    const std::uint_least64_t &index, std::true_type) {
+        URNG random_generator(seed);
+        for (std::uint_least64_t i = 0; i < index; ++i)
+            random_generator.Jump();
+        return random_generator;
+    }
+
+    // The generator of stream `index` of `seed`: Xoshiro256 streams are
+    // 2^128 apart in one sequence, and other generators are seeded through
+    // std::seed_seq. Keep `index` small for Xoshiro256, since every stream
+    // costs a jump.
+    template <class URNG>
+    URNG SeedStream(const std::uint_least64_t &seed,
+                    const std::uint_least64_t &index) {
+        return SeedStream<URNG>(seed, index,
+                                std::is_same<URNG, Xoshiro256>());
+    }
+
+    // Whether every call of URNG yields 64 uniform bits.
+    template <class URNG>
+    using HasFullBits64 = std::integral_constant<
+        bool, URNG::min() == 0 &&
+                  URNG::max() ==
+                      std::numeric_limits<std::uint_least64_t>::max()>;
+
+    template <class URNG>
+    double UniformReal(URNG &random_generator, std::true_type) {
+        return (random_generator() >> 11) * (1.0 / (1ull << 53));
+    }
+
+    template <class URNG>
+    double UniformReal(URNG &random_generator, std::false_type) {
+        return std::uniform_real_distribution<double>(0.0, 1.0)(
+            random_generator);
+    }
+
+    // Uniform in [0, 1).
+    template <class URNG>
+    double UniformReal(URNG &random_generator) {
+        return UniformReal(random_generator, HasFullBits64<URNG>());
+    }
+
+    // Lemire's multiply-and-reject method on the high 32 bits.
+    template <class URNG>
+    std::uint_least32_t UniformInt(URNG &random_generator,
+                                   const std::uint_least32_t &bound,
+                                   std::true_type) {
+        std::uint_least64_t m = (random_generator() >> 32) * bound;
+        auto low = static_cast<std::uint_least32_t>(m);
+        if (low < bound) {
+            const std::uint_least32_t threshold =
+                static_cast<std::uint_least32_t>(-bound) % bound;
+            while (low < threshold) {
+                m = (random_generator() >> 32) * bound;
+                low = static_cast<std::uint_least32_t>(m);
+            }
+        }
+        return static_cast<std::uint_least32_t>(m >> 32);
+    }
+
+    template <class URNG>
+    std::uint_least32_t UniformInt(URNG &random_generator,
+                                   const std::uint_least32_t &bound,
+                                   std::false_type) {
+        return std::uniform_int_distribution<std::uint_least32_t>(
+            0, bound - 1)(random_generator);
+    }
+
+    // Uniform in [0, bound), bound being positive.
+    template <class URNG>
+    std::uint_least32_t UniformInt(URNG &random_generator,
+                                   const std::uint_least32_t &bound) {
+        return UniformInt(random_generator, bound, HasFullBits64<URNG>());
+    }
+
 #ifdef SokobanQLearning_USE_EMOJI_
     std::string MazeToEmoji(const std::string &maze) {
         std::string ret;
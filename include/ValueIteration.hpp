@@ -0,0 +1,225 @@
+#ifndef SokobanQLearning_ValueIteration_HPP_
+#define SokobanQLearning_ValueIteration_HPP_ 1
+
+#include "./Parallel.hpp"
+#include "./Sokoban.hpp"
+#include "./SokobanQLearning.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+namespace SokobanQLearning {
+    struct ValueIterationStats {
+        std::size_t States = 0, Edges = 0, Iterations = 0;
+        double Residual = 0, BuildSeconds = 0, SolveSeconds = 0;
+        bool Converged = false;
+
+        void Print(std::ostream &os, int precision) const {
+            os << "States: " << States << std::endl
+               << "Transitions: " << Edges << std::endl
+               << "Iterations: " << Iterations
+               << (Converged ? "" : " (not converged)") << std::endl
+               << std::scientific << std::setprecision(precision)
+               << "Residual: " << Residual << std::endl
+               << std::fixed << "Build: " << BuildSeconds << "s" << std::endl
+               << "Solve: " << SolveSeconds << "s" << std::endl;
+        }
+    };
+
+    // Exact state values over the graph of states reachable from the start
+    // of a game, under the rewards of Act and the bootstrap rule of Backup:
+    // a finished state is worth 0, or min_Q if it has no legal action. The
+    // retrace penalty depends on the episode history, so it never applies
+    // here. Transitions are stored in CSR form: the edges leaving state i
+    // are Edges[Offsets[i]] to Edges[Offsets[i + 1] - 1], and a state
+    // without edges is finished.
+    template <class RealType, std::size_t StateBits>
+    class ValueIteration {
+    public:
+        typedef typename Sokoban::Game<StateBits>::StateType StateType;
+        typedef std::uint_least32_t IndexType;
+
+        struct Edge {
+            IndexType Next;
+            Sokoban::DirectionInt Action;
+            RealType Reward;
+        };
+
+    protected:
+        std::vector<StateType> _states;
+        std::vector<IndexType> _offsets;
+        std::vector<Edge> _edges;
+        std::vector<RealType> _final_values;
+        std::unique_ptr<std::atomic<RealType>[]> _values, _next_values;
+        RealType _gamma;
+        ValueIterationStats _stats;
+
+        RealType StateValue(const std::size_t &i,
+                            const std::atomic<RealType> *values) const {
+            if (_offsets[i] == _offsets[i + 1]) return _final_values[i];
+            RealType value = std::numeric_limits<RealType>::lowest();
+            for (auto e = _offsets[i]; e < _offsets[i + 1]; ++e)
+                value = std::max(
+                    value,
+                    _edges[e].Reward +
+                        _gamma * values[_edges[e].Next].load(
+                                     std::memory_order_relaxed));
+            return value;
+        }
+
+    public:
+        const ValueIterationStats &GetStats() const { return _stats; }
+
+        const std::vector<StateType> &GetStates() const { return _states; }
+
+        // Enumerates the reachable states breadth first. Returns false, and
+        // keeps no graph, if there are more than `max_states` of them.
+        bool Build(const Sokoban::Game<StateBits> &game,
+                   const TrainParams<RealType> &params,
+                   const std::size_t &max_states) {
+            const auto start = std::chrono::steady_clock::now();
+            _states.clear();
+            _offsets.assign(1, 0);
+            _edges.clear();
+            _final_values.clear();
+            std::unordered_map<StateType, IndexType> index;
+            auto scratch = game;
+            scratch.Restart();
+            _states.push_back(scratch.GetState());
+            index.emplace(scratch.GetState(), 0);
+            const auto min_Q = params.MinQ(game.GetBoxPos0().size());
+            for (std::size_t i = 0; i < _states.size(); ++i) {
+                scratch.Restore(_states[i]);
+                const auto actions = scratch.GetDirections();
+                if (scratch.GetSucceeded() || scratch.GetFailed()) {
+                    _final_values.push_back(actions ? 0 : min_Q);
+                    _offsets.push_back(_edges.size());
+                    continue;
+                }
+                _final_values.push_back(0);
+                for (const auto &d : Sokoban::AllDirections) {
+                    if (!(actions & d)) continue;
+                    scratch.Restore(_states[i]);
+                    const auto &transition = Act(scratch, d, params);
+                    const auto &inserted =
+                        index.emplace(transition.State, _states.size());
+                    if (inserted.second) {
+                        if (_states.size() >= max_states) {
+                            _states.clear();
+                            _offsets.assign(1, 0);
+                            _edges.clear();
+                            _final_values.clear();
+                            return false;
+                        }
+                        _states.push_back(transition.State);
+                    }
+                    _edges.push_back(
+                        {inserted.first->second, d, transition.Reward});
+                }
+                _offsets.push_back(_edges.size());
+            }
+            _values.reset(new std::atomic<RealType>[_states.size()]);
+            for (std::size_t i = 0; i < _states.size(); ++i)
+                _values[i].store(0, std::memory_order_relaxed);
+            _next_values.reset();
+            _stats = ValueIterationStats();
+            _stats.States = _states.size();
+            _stats.Edges = _edges.size();
+            _stats.BuildSeconds = std::chrono::duration<double>(
+                                      std::chrono::steady_clock::now() - start)
+                                      .count();
+            return true;
+        }
+
+        // Sweeps the graph until no value changes by more than `tolerance`
+        // or `max_iterations` sweeps have been made, each sweep split into
+        // contiguous ranges of states over `thread_count` threads. The
+        // threads are started once and meet at a barrier after every sweep.
+        // A synchronous sweep reads only the previous sweep's values; a
+        // Gauss-Seidel sweep updates in place and reads whatever value is
+        // current, which usually converges in fewer sweeps.
+        const ValueIterationStats &Solve(const RealType &gamma,
+                                         const RealType &tolerance,
+                                         const std::size_t &max_iterations,
+                                         const std::size_t &thread_count,
+                                         bool gauss_seidel) {
+            const auto start = std::chrono::steady_clock::now();
+            _gamma = gamma;
+            const std::size_t count = _states.size();
+            const std::size_t threads =
+                std::max(static_cast<std::size_t>(1),
+                         std::min(thread_count, count));
+            if (!gauss_seidel && !_next_values)
+                _next_values.reset(new std::atomic<RealType>[count]);
+            std::vector<RealType> residuals(threads);
+            _stats.Converged = false;
+            bool done = _stats.Iterations >= max_iterations;
+            Barrier barrier(threads);
+            // Run by the last thread to finish a sweep.
+            const auto finish_sweep = [&]() -> void {
+                if (!gauss_seidel) std::swap(_values, _next_values);
+                ++_stats.Iterations;
+                _stats.Residual =
+                    *std::max_element(residuals.begin(), residuals.end());
+                _stats.Converged = _stats.Residual <= tolerance;
+                done = _stats.Converged || _stats.Iterations >= max_iterations;
+            };
+            if (!done)
+                RunThreads(threads, [&](const std::size_t &thread) -> void {
+                    const auto first = count * thread / threads;
+                    const auto last = count * (thread + 1) / threads;
+                    while (!done) {
+                        const std::atomic<RealType> *from = _values.get();
+                        std::atomic<RealType> *to =
+                            gauss_seidel ? _values.get() : _next_values.get();
+                        RealType residual = 0;
+                        for (auto i = first; i < last; ++i) {
+                            const auto value = StateValue(i, from);
+                            const auto old =
+                                from[i].load(std::memory_order_relaxed);
+                            residual =
+                                std::max(residual, std::abs(value - old));
+                            to[i].store(value, std::memory_order_relaxed);
+                        }
+                        residuals[thread] = residual;
+                        barrier.Wait(finish_sweep);
+                    }
+                });
+            _stats.SolveSeconds += std::chrono::duration<double>(
+                                       std::chrono::steady_clock::now() - start)
+                                       .count();
+            return _stats;
+        }
+
+        RealType Value(const std::size_t &i) const {
+            return _values[i].load(std::memory_order_relaxed);
+        }
+
+        // Writes Q(s, a) = r + gamma * V(s') for every unfinished state.
+        void Export(IQTable<RealType, StateBits> &Q) const {
+            for (std::size_t i = 0; i < _states.size(); ++i) {
+                if (_offsets[i] == _offsets[i + 1]) continue;
+                typename IQTable<RealType, StateBits>::RowType row{
+                    {0, 0, 0, 0}};
+                for (auto e = _offsets[i]; e < _offsets[i + 1]; ++e)
+                    row[Sokoban::DirectionIndex(_edges[e].Action)] =
+                        _edges[e].Reward + _gamma * Value(_edges[e].Next);
+                Q.Set(_states[i], row);
+            }
+        }
+
+        ValueIteration() : _offsets(1, 0), _gamma(1) {}
+    };
+}  // namespace SokobanQLearning
+
+#endif  // SokobanQLearning_ValueIteration_HPP_